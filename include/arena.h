@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// linear allocator for per-frame data: allocations are a pointer bump and
+// the whole arena is released at once with arena_reset()
+typedef struct arena_block
+{
+  struct arena_block *previous; // blocks added while growing during a frame
+  size_t capacity;              // bytes of data following this header
+  size_t used;
+} arena_block_t;
+
+typedef struct
+{
+  arena_block_t *block; // current block
+  size_t capacity;      // total capacity of all chained blocks
+  size_t used;          // bytes handed out since the last reset
+  size_t high_water;    // largest number of bytes used in a single frame
+} arena_t;
+
+void arena_init(arena_t *arena, size_t capacity);
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_grow(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+void arena_reset(arena_t *arena);
+void arena_free(arena_t *arena);
+
+#endif // !ARENA_H
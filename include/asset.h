@@ -0,0 +1,72 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// decode the bytes of a file into an asset, NULL on failure; the content hash
+// lets loaders check data derived from the file offline is still current
+typedef void *(*asset_load_t)(const char *path, const unsigned char *bytes, size_t size, uint64_t content_hash);
+typedef void (*asset_free_t)(void *data);
+
+// told about every asset the registry decoded, with the time spent mapping,
+// hashing and decoding its file
+typedef void (*asset_loaded_t)(void *data, uint64_t load_ns);
+
+typedef struct
+{
+  uint64_t content_hash; // FNV-1a hash of the file bytes
+  size_t content_size;   // file size, so a hash collision alone never shares an asset
+  void *data;            // NULL once the last reference is released, the entry is reused then
+  int refcount;
+} asset_t;
+
+typedef struct
+{
+  char *path;    // NULL once the asset is released, the entry is reused then
+  uint64_t path_hash;
+  int asset;     // index in the registry assets
+} asset_path_t;
+
+// shared, reference counted assets keyed by file path and content hash: a path
+// seen before is a lookup only, a new path whose bytes have the hash and size
+// of an asset that is already loaded shares it without decoding it again
+typedef struct
+{
+  asset_t *assets;     // dynamic array of assets
+  asset_path_t *paths; // dynamic array of every path an asset was requested by
+  asset_load_t load;
+  asset_free_t free;
+  asset_loaded_t loaded; // optional
+} asset_registry_t;
+
+uint64_t fnv1a_hash(const void *bytes, size_t size);
+
+// the path with its extension replaced, for files derived from an asset and
+// stored next to it; false when it does not fit
+bool replace_path_extension(const char *path, const char *extension, char *result, size_t result_size);
+
+// whole file in a malloc() buffer, or mapped read-only into memory where the
+// platform allows it; NULL when the file cannot be read
+unsigned char *read_file(const char *path, size_t *size);
+const unsigned char *map_file(const char *path, size_t *size);
+void unmap_file(const unsigned char *bytes, size_t size);
+
+void *asset_acquire(asset_registry_t *registry, const char *path);
+
+// the asset of a path loaded before, NULL when it has not been; no file access
+void *asset_acquire_cached(asset_registry_t *registry, const char *path);
+
+// asset_acquire() split in two for loading on other threads: decoding the
+// file does not touch the registry and can run on any thread, adopting the
+// decoded data runs on the thread owning the registry and frees it again when
+// the path or the same bytes were loaded in the meantime
+void *asset_decode(asset_registry_t *registry, const char *path, uint64_t *content_hash, size_t *content_size);
+void *asset_adopt(asset_registry_t *registry, const char *path, uint64_t content_hash, size_t content_size, void *data, uint64_t load_ns);
+
+void asset_release(asset_registry_t *registry, void *data);
+int asset_count(asset_registry_t *registry);
+void asset_registry_free(asset_registry_t *registry);
+
+#endif // !ASSET_H
@@ -0,0 +1,46 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include "asset.h"
+#include <stdint.h>
+
+// files are mapped, hashed and decoded on a pool of worker threads, one per
+// logical core up to this many
+#define MAX_ASSET_LOADER_THREADS 4
+
+// called with a reference to the loaded asset, NULL when the file could not
+// be loaded
+typedef void (*asset_ready_t)(void *data, void *user_data);
+
+typedef struct
+{
+  int num_threads;
+  int num_loaded; // files decoded by the workers
+  int num_failed;
+  double decode_ns_sum;      // worker time spent on the files
+  uint64_t first_request_ns; // 0 before the first request
+  uint64_t last_ready_ns;    // when the last callback so far was called
+} asset_loader_stats_t;
+
+// without workers every request is decoded right away on the calling thread
+void start_asset_loader(void);
+
+// registries are not thread safe: requests and finish_asset_loads() have to
+// come from the thread owning the registries. a path loaded before calls
+// on_ready right away, a path being loaded already only adds the callback
+void load_asset_async(asset_registry_t *registry, const char *path, asset_ready_t on_ready, void *user_data);
+
+// decode the file again without the registry, for data that was dropped and
+// is needed back; on_ready owns what it gets and frees it with registry->free
+void decode_asset_async(asset_registry_t *registry, const char *path, asset_ready_t on_ready, void *user_data);
+
+// hand the assets decoded since the last call to their registries and call
+// their callbacks; returns the number of requests still loading
+int finish_asset_loads(void);
+
+asset_loader_stats_t get_asset_loader_stats(void);
+
+// unfinished loads are dropped without calling their callbacks
+void stop_asset_loader(void);
+
+#endif // !ASSET_LOADER_H
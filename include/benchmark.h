@@ -0,0 +1,76 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "camera.h"
+#include "vector.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+// scripted runs for comparing builds: the camera follows a path keyed by the
+// frame number instead of input and time, so every run draws the same frames,
+// and the stages of every frame are timed
+enum benchmark_path
+{
+  BENCHMARK_PATH_ORBIT, // one turn around the scene, looking at its center
+  BENCHMARK_PATH_DOLLY  // from far away into the scene, so faces get clipped at the end
+};
+
+enum benchmark_stage
+{
+  BENCHMARK_STAGE_TRANSFORM, // vertex transform, face culling, lighting and projection into the render queue
+  BENCHMARK_STAGE_CULL,      // instance frustum and occlusion culling
+  BENCHMARK_STAGE_CLIP,      // clipping the faces crossing the frustum
+  BENCHMARK_STAGE_RASTER,    // drawing the render queue on the raster thread
+  BENCHMARK_STAGE_PRESENT,   // uploading and presenting on the main thread
+  NUM_BENCHMARK_STAGES
+};
+
+typedef struct
+{
+  int num_samples;
+  double mean_ms;
+  double p50_ms;
+  double p99_ms;
+} benchmark_stage_stats_t;
+
+// what a run drew, for the report
+typedef struct
+{
+  const char *scene;
+  int path;
+  int width;
+  int height;
+  const char *render_method;
+  int num_frames;
+  int num_instances;
+} benchmark_run_t;
+
+bool parse_benchmark_path(const char *name, int *path);
+const char *get_benchmark_path_name(int path);
+const char *get_benchmark_stage_name(int stage);
+
+// camera of a frame, around or into the sphere bounding the scene
+camera_t get_benchmark_camera(int path, vec3_t center, float radius, int frame, int num_frames);
+
+// updates the scene from the camera and hands the frame to the raster thread
+typedef void (*benchmark_frame_t)(camera_t camera);
+
+// on the geometry thread: wait for the assets to load, then record the frames
+// along the path around the loaded scene, stopping early once is_running is 0
+void run_benchmark(int path, int num_frames, benchmark_frame_t draw_frame, SDL_AtomicInt *is_running);
+
+// samples are only kept between start and stop; each stage is recorded from
+// one thread only, the one running it
+void start_benchmark_recording(void);
+void stop_benchmark_recording(void);
+void record_benchmark_sample(int stage, double ns);
+
+benchmark_stage_stats_t get_benchmark_stage_stats(int stage);
+
+// print the stage timings, and append them to the JSON lines file when a
+// path is given, one object per run
+void report_benchmark(const benchmark_run_t *run, const char *json_path);
+
+void free_benchmark(void);
+
+#endif // !BENCHMARK_H
@@ -0,0 +1,64 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "clipping.h"
+#include "vector.h"
+#include <stdbool.h>
+
+typedef struct
+{
+  vec3_t min;
+  vec3_t max;
+} aabb_t;
+
+// leaves hold up to BVH_MAX_LEAF_ITEMS items
+#define BVH_MAX_LEAF_ITEMS 4
+
+typedef struct
+{
+  aabb_t bounds;
+  int parent;     // -1 for the root
+  int left;       // child nodes, -1 for leaves
+  int right;
+  int first_item; // leaves only: range in the bvh items array
+  int num_items;
+  bool is_dirty;  // leaves only: queued for the next refit
+} bvh_node_t;
+
+// bounding volume hierarchy over items identified by their index; the tree is
+// built once and refit when item bounds change, so it stays valid as objects
+// move (but not optimal, rebuild after large changes)
+typedef struct
+{
+  bvh_node_t *nodes;   // dynamic array of nodes, the root is node 0
+  int *items;          // dynamic array of item indices, grouped by leaf
+  aabb_t *item_bounds; // dynamic array of bounds, indexed by item
+  int *item_leaves;    // dynamic array of the leaf holding each item
+  int *dirty_leaves;   // dynamic array of leaves whose items moved
+} bvh_t;
+
+// an empty box is contained in nothing and overlaps nothing, items with empty
+// bounds stay in the tree but are never returned by queries
+aabb_t aabb_empty(void);
+bool aabb_is_empty(aabb_t box);
+aabb_t aabb_from_sphere(vec3_t center, float radius);
+aabb_t aabb_union(aabb_t a, aabb_t b);
+bool aabb_overlaps(aabb_t a, aabb_t b);
+
+void bvh_build(bvh_t *bvh, aabb_t *item_bounds, int num_items);
+void bvh_set_item_bounds(bvh_t *bvh, int item, aabb_t bounds);
+void bvh_refit(bvh_t *bvh);
+
+// surface area of all nodes relative to the root, how many nodes a query for
+// a random point in the root visits on average; refits that spread the items
+// apart raise it over the cost of a freshly built tree
+float bvh_get_cost(bvh_t *bvh);
+
+// queries append the indices of the matching items to a dynamic array
+void bvh_query_frustum(bvh_t *bvh, plane_t planes[NUM_PLANES], int **items);
+void bvh_query_box(bvh_t *bvh, aabb_t box, int **items);
+void bvh_query_ray(bvh_t *bvh, vec3_t origin, vec3_t direction, float max_distance, int **items);
+
+void bvh_free(bvh_t *bvh);
+
+#endif // !BVH_H
@@ -29,4 +29,9 @@ void rotate_camera_pitch(float angle);
 
 vec3_t get_camera_lookat_target(void);
 
+// copy of the camera state, and a blend of two of them for rendering between
+// simulation steps; the direction follows the blended angles
+camera_t get_camera(void);
+camera_t interpolate_camera(camera_t from, camera_t to, float t);
+
 #endif // !CAMERA_H
@@ -1,9 +1,11 @@
 #ifndef CLIPPING_H
 #define CLIPPING_H
 
+#include "matrix.h"
 #include "texture.h"
 #include "triangle.h"
 #include "vector.h"
+#include <stdbool.h>
 
 #define MAX_NUM_POLY_VERTICES 10
 #define MAX_NUM_POLY_TRIANGLES 10
@@ -17,6 +19,29 @@ enum
   NEAR_FRUSTUM_PLANE,
   FAR_FRUSTUM_PLANE
 };
+#define NUM_PLANES 6
+
+// outcode bits, one per frustum plane the vertex lies outside of
+#define OUTCODE_LEFT (1 << LEFT_FRUSTUM_PLANE)
+#define OUTCODE_RIGHT (1 << RIGHT_FRUSTUM_PLANE)
+#define OUTCODE_TOP (1 << TOP_FRUSTUM_PLANE)
+#define OUTCODE_BOTTOM (1 << BOTTOM_FRUSTUM_PLANE)
+#define OUTCODE_NEAR (1 << NEAR_FRUSTUM_PLANE)
+#define OUTCODE_FAR (1 << FAR_FRUSTUM_PLANE)
+#define OUTCODE_SIDES (OUTCODE_LEFT | OUTCODE_RIGHT | OUTCODE_TOP | OUTCODE_BOTTOM)
+
+enum triangle_visibility
+{
+  TRIANGLE_INSIDE,  // trivially accepted, no clipping needed
+  TRIANGLE_OUTSIDE, // trivially rejected, all vertices outside the same plane
+  TRIANGLE_CLIPPED  // crosses a plane, must go through clip_polygon()
+};
+
+enum clip_method
+{
+  CLIP_FRUSTUM,
+  CLIP_GUARD_BAND
+};
 
 typedef struct
 {
@@ -31,7 +56,15 @@ typedef struct
   int num_vertices;
 } polygon_t;
 
+void set_clip_method(int method);
+bool is_clip_guard_band(void);
+
 void init_frustum_planes(float fov_x, float fov_y, float z_near, float z_far);
+int compute_outcode(vec3_t vertex);
+int classify_triangle(vec3_t v0, vec3_t v1, vec3_t v2);
+bool is_sphere_outside_frustum(vec3_t center, float radius);
+void get_world_frustum_planes(mat4_t view_matrix, plane_t planes[NUM_PLANES]);
+
 polygon_t polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2);
 void triangles_from_polygon(polygon_t *polygon, triangle_t triangles[], int *num_triangles);
 void clip_polygon(polygon_t *polygon);
@@ -0,0 +1,55 @@
+#ifndef COOKED_MESH_H
+#define COOKED_MESH_H
+
+#include "mesh.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// binary mesh written offline by the cook tool next to its OBJ file: the
+// parsed and welded vertices and every level of detail with its face planes,
+// meshlets and indices, so loading is a file mapping instead of parsing and simplifying.
+// each array is stored 16 byte aligned right after the two int header of a
+// dynamic array, so the mesh arrays point into the mapping and
+// array_length() works on them; they must never be grown or freed.
+#define COOKED_MESH_EXTENSION ".mesh"
+#define COOKED_MESH_MAGIC 0x4853454d4b4f4f43ULL // "COOKMESH"
+#define COOKED_MESH_VERSION 2
+#define COOKED_MESH_ALIGNMENT 16
+
+typedef struct
+{
+  uint64_t offset; // file offset of the first item
+  uint32_t count;
+  uint32_t item_size; // catches files cooked by a build with another layout
+} cooked_array_t;
+
+typedef struct
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t num_lods;
+  uint64_t source_hash; // FNV-1a hash of the OBJ file bytes it was cooked from
+  vec3_t bounds_center;
+  float bounds_radius;
+  float cache_miss_ratio_before;
+  float cache_miss_ratio_after;
+  cooked_array_t vertices;
+  cooked_array_t welded_vertices;
+  cooked_array_t faces[MAX_NUM_MESH_LODS];
+  cooked_array_t face_planes[MAX_NUM_MESH_LODS];
+  cooked_array_t meshlets[MAX_NUM_MESH_LODS];
+  cooked_array_t indices[MAX_NUM_MESH_LODS];
+} cooked_mesh_header_t;
+
+// the OBJ path with its extension replaced, false when it does not fit
+bool get_cooked_mesh_path(const char *obj_path, char *path, size_t path_size);
+
+bool write_cooked_mesh(const char *path, mesh_t *mesh, uint64_t source_hash);
+
+// false when the file is missing, cooked from other OBJ bytes or by another
+// build; the mesh then is left untouched
+bool load_cooked_mesh(mesh_t *mesh, const char *path, uint64_t source_hash);
+
+#endif // !COOKED_MESH_H
@@ -0,0 +1,38 @@
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include "texture.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// decoded texels of a PNG file, written next to it the first time it is
+// decoded, so later runs map the texels instead of inflating and unfiltering
+// the PNG again. the texels are stored 64 byte aligned in the row order the
+// rasterizer samples them in
+#define COOKED_TEXTURE_EXTENSION ".tex"
+#define COOKED_TEXTURE_MAGIC 0x005845544b4f4f43ULL // "COOKTEX"
+#define COOKED_TEXTURE_VERSION 1
+#define COOKED_TEXTURE_ALIGNMENT 64
+
+typedef struct
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t texel_size;  // catches files written by a build with another texel layout
+  uint64_t source_hash; // FNV-1a hash of the PNG file bytes it was decoded from
+  uint32_t width;
+  uint32_t height;
+  uint64_t texels_offset;
+} cooked_texture_header_t;
+
+// the PNG path with its extension replaced, false when it does not fit
+bool get_cooked_texture_path(const char *png_path, char *path, size_t path_size);
+
+bool write_cooked_texture(const char *path, const texture_level_t *level, uint64_t source_hash);
+
+// false when the file is missing, decoded from other PNG bytes or by another
+// build; the level then is left untouched
+bool load_cooked_texture(texture_level_t *level, const char *path, uint64_t source_hash);
+
+#endif // !COOKED_TEXTURE_H
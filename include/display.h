@@ -5,8 +5,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// default frame rate target of the frame scheduler
 #define FPS 60
-#define FRAME_TARGET_TIME (1000 / FPS)
+
+// one color buffer being drawn, one holding the newest complete frame and
+// one being shown, so drawing never waits for the upload or vsync
+#define NUM_COLOR_BUFFERS 3
+
+// where the frames go, see display_backend.h
+enum display_backend
+{
+  DISPLAY_BACKEND_SDL,     // a fullscreen window
+  DISPLAY_BACKEND_HEADLESS // no window, for machines without a display
+};
 
 enum cull_method
 {
@@ -24,18 +35,30 @@ enum render_method
   RENDER_TEXTURED_WIRE,
 };
 
+bool parse_display_backend(const char *name, int *backend);
+
+// both called before initialize_window(); a resolution of 0 by 0 leaves it
+// to the backend
+void set_display_backend(int backend);
+void set_display_resolution(int width, int height);
+
 bool initialize_window(void);
 int get_window_width(void);
 int get_window_height(void);
 
+bool parse_render_method(const char *name, int *method);
+const char *get_render_method_name(int method);
 void set_render_method(int method);
+int get_render_method(void);
 void set_cull_method(int method);
 bool is_cull_backface(void);
 
-bool should_render_filled_triangles(void);
-bool should_render_textured_triangle(void);
-bool should_render_wireframe(void);
-bool should_render_wire_vertex(void);
+// the raster stage asks with the render method of the frame it is drawing,
+// which can be older than the current one
+bool should_render_filled_triangles(int method);
+bool should_render_textured_triangle(int method);
+bool should_render_wireframe(int method);
+bool should_render_wire_vertex(int method);
 
 void draw_pixel(int x, int y, uint32_t color);
 void draw_line(int x0, int y0, int x1, int y1, uint32_t color);
@@ -43,7 +66,20 @@ void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t colo
 void draw_grid(void);
 void draw_rect(int x, int y, int width, int height, uint32_t color);
 
-void render_color_buffer(void);
+// drawing functions write to the target color buffer
+void set_color_buffer_target(int index);
+
+// write every interval-th presented frame to <prefix>NNNNN.ppm, numbered
+// from the first presented frame; 0 writes none
+void set_frame_dump(const char *prefix, int interval);
+
+// write the next presented frame, with the prefix set before or "frame";
+// any thread can ask
+void request_frame_dump(void);
+
+// copy a color buffer to the window, then show it (waits for vsync)
+void render_color_buffer(int index);
+void present_color_buffer(void);
 void clear_color_buffer(uint32_t color);
 void clear_z_buffer(void);
 
@@ -0,0 +1,28 @@
+#ifndef DISPLAY_BACKEND_H
+#define DISPLAY_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// where the finished color buffers go; display.c owns the buffers and the
+// drawing, a backend only opens the output at a size and shows frames
+typedef struct
+{
+  // width and height hold the requested size, 0 for the backend default,
+  // and are set to the size the color buffers are allocated at
+  bool (*open)(int *width, int *height);
+
+  // copy a frame of RGBA32 pixels to the output, then show it
+  void (*upload)(const uint32_t *pixels, int width, int height);
+  void (*present)(void);
+
+  void (*close)(void);
+} display_backend_t;
+
+// a borderless fullscreen window at a third of the display resolution
+extern const display_backend_t sdl_display_backend;
+
+// no window or display, frames are only kept in memory and dumped on request
+extern const display_backend_t headless_display_backend;
+
+#endif // !DISPLAY_BACKEND_H
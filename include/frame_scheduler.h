@@ -0,0 +1,55 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <stdbool.h>
+
+// frame pacing, kept apart from the simulation and the geometry work so each
+// mode can be measured on its own; all timing is in nanoseconds
+enum frame_schedule_mode
+{
+  FRAME_SCHEDULE_UNCAPPED,   // frames start back to back, for measuring throughput
+  FRAME_SCHEDULE_FIXED_STEP, // simulation in fixed steps, frames interpolated between them
+  FRAME_SCHEDULE_ADAPTIVE    // paced to the target rate, lowered while frames cannot keep up
+};
+
+// the adaptive mode divides the target rate by up to this much
+#define MAX_FRAME_RATE_DIVISOR 4
+
+// the fixed step mode never simulates more than this per frame, so a long
+// stall does not make the next frames fall further behind
+#define MAX_FRAME_STEP_TIME 0.25
+
+typedef struct
+{
+  int num_steps;       // simulation steps to run before building the frame
+  float step_time;     // seconds each step simulates
+  float interpolation; // where the frame lies between the last two steps, 0 to 1
+} frame_schedule_t;
+
+typedef struct
+{
+  int num_frames;
+  double mean_ms; // frame start to the next frame start
+  double p50_ms;
+  double p99_ms;
+  double max_ms;
+  double mean_work_ms; // frame start to end_frame(), without the pacing wait
+  int rate_divisor;    // adaptive mode rate divisor at the end
+} frame_time_stats_t;
+
+bool parse_frame_schedule_mode(const char *name, int *mode);
+const char *get_frame_schedule_mode_name(int mode);
+
+void init_frame_scheduler(int mode, int target_fps);
+
+// waits as long as the mode asks for, then starts the frame
+frame_schedule_t begin_frame(void);
+
+// stage_ns is the time of a pipeline stage running beside this thread; the
+// adaptive mode paces by whichever of it and the frame work is slower
+void end_frame(double stage_ns);
+
+frame_time_stats_t get_frame_time_stats(void);
+void free_frame_scheduler(void);
+
+#endif // !FRAME_SCHEDULER_H
@@ -0,0 +1,51 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "bvh.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "texture.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// placement of a shared mesh in the scene; many instances can point at the
+// same mesh and texture, so memory does not grow with the instance count
+typedef struct
+{
+  mesh_t *mesh;       // shared geometry
+  texture_t *texture; // shared texture
+  vec3_t rotation;    // rotation x, y, and z values
+  vec3_t scale;       // scale with x, y, and z values
+  vec3_t translation; // translation with x, y, and z values
+  int current_lod;    // level of detail selected in the last frame
+  bool is_occluder;   // drawn into the occlusion buffer to hide other instances
+} instance_t;
+
+// stable reference to an instance; a handle whose instance was removed no
+// longer resolves, even after its slot is reused by a new instance
+typedef struct
+{
+  int slot;
+  uint32_t generation; // 0 is never used, so a zeroed handle is invalid
+} instance_handle_t;
+
+// the instance takes over the caller's mesh and texture references
+instance_handle_t add_instance(mesh_t *mesh, texture_t *texture, vec3_t scale, vec3_t translation, vec3_t rotation);
+void remove_instance(instance_handle_t handle);
+instance_t *get_instance(instance_handle_t handle);
+bool set_instance_transform(instance_handle_t handle, vec3_t scale, vec3_t rotation, vec3_t translation);
+
+// the live instances are packed at the start of one array, in no particular order
+int get_num_instances(void);
+instance_t *get_instances(void);
+
+// scene queries over a bounding volume hierarchy of the instance world bounds;
+// visible instances replace the contents of the array, the others append to it
+void query_visible_instances(mat4_t view_matrix, instance_handle_t **visible);
+void query_instances_in_box(aabb_t box, instance_handle_t **results);
+void query_instances_along_ray(vec3_t origin, vec3_t direction, float max_distance, instance_handle_t **results);
+
+void free_instances(void);
+
+#endif // !INSTANCE_H
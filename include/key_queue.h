@@ -0,0 +1,16 @@
+#ifndef KEY_QUEUE_H
+#define KEY_QUEUE_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+// key presses handed from the thread polling SDL events to the geometry
+// thread, which owns the camera and the render settings; single producer,
+// single consumer, without locks
+#define KEY_QUEUE_SIZE 64
+
+// drops the key when the queue is full
+void push_key(SDL_Keycode key);
+bool pop_key(SDL_Keycode *key);
+
+#endif // !KEY_QUEUE_H
@@ -20,5 +20,8 @@ vec4_t mat4_mul_vec4(mat4_t m, vec4_t v);
 mat4_t mat4_mul_mat4(mat4_t a, mat4_t b);
 vec4_t mat4_mul_vec4_project(mat4_t mat_proj, vec4_t v);
 mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up);
+mat4_t mat4_make_world(vec3_t scale, vec3_t rotation, vec3_t translation);
+mat4_t mat4_make_inverse_world(vec3_t scale, vec3_t rotation, vec3_t translation);
+mat4_t mat4_transpose(mat4_t m);
 
 #endif // !MATRIX_H
@@ -1,26 +1,89 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "asset_loader.h"
 #include "triangle.h"
-#include "upng.h"
 #include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// plane of a face in model space: dot(normal, p) == distance for points on the face
+typedef struct
+{
+  vec3_t normal;
+  float distance;
+} face_plane_t;
+
+// cluster of up to MESHLET_MAX_FACES spatially close faces that can be
+// rejected as a whole before any of its vertices are transformed
+#define MESHLET_MAX_FACES 64
+
+typedef struct
+{
+  int first_face;   // index of the first face in mesh faces / face_planes
+  int num_faces;
+  vec3_t center;    // bounding sphere in model space
+  float radius;
+  vec3_t cone_axis; // average direction of the face normals
+  float cone_sin;   // sine of the cone half-angle, 1 when the cone is too wide to cull
+} meshlet_t;
+
+// unique position and UV pair of the faces, welded at load time
+typedef struct
+{
+  vec3_t position;
+  tex2_t uv;
+} mesh_vertex_t;
+
+// one level of detail of a mesh; all levels index the same mesh vertices
+typedef struct
+{
+  face_t *faces;             // dynamic array of faces
+  face_plane_t *face_planes; // dynamic array of face planes, one per face
+  meshlet_t *meshlets;       // dynamic array of meshlets covering all faces
+  uint32_t *indices;         // dynamic array of welded vertex indices, three per face
+} mesh_lod_t;
+
+// level 0 is the loaded mesh, every further level has about half the faces
+#define MAX_NUM_MESH_LODS 4
 
 typedef struct
 {
   vec3_t *vertices;   // dynamic array of vertices
-  face_t *faces;      // dynamic array of faces
-  upng_t *texture;    // mesh PNG texture of faces
-  vec3_t rotation;    // rotation x, y, and z values
-  vec3_t scale;       // scale with x, y, adn z values
-  vec3_t translation; // translation with x, y, and z values
+  mesh_vertex_t *welded_vertices; // dynamic array of the welded vertices of all levels
+  mesh_lod_t lods[MAX_NUM_MESH_LODS];
+  int num_lods;
+  vec3_t bounds_center; // bounding sphere of all vertices in model space
+  float bounds_radius;
+  float cache_miss_ratio_before; // vertex cache misses per level 0 face in file order
+  float cache_miss_ratio_after;  // and in the optimized order
+  const unsigned char *cooked_data; // mapped cooked file the arrays point into, NULL when parsed
+  size_t cooked_size;
 } mesh_t;
 
-void load_mesh(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation);
-void load_mesh_obj_data(mesh_t *mesh, char *obj_filename);
-void load_mesh_png_data(mesh_t *mesh, char *png_filename);
+// meshes mapped from cooked files and parsed from OBJ files, and the time
+// spent mapping, hashing and decoding their files
+typedef struct
+{
+  int num_cooked;
+  int num_parsed;
+  double load_ns_sum;
+  double cache_miss_ratio_before_sum;
+  double cache_miss_ratio_after_sum;
+} mesh_load_stats_t;
+
+// geometry shared by every instance placing the mesh in the scene
+mesh_t *load_mesh(char *obj_filename);
+void load_mesh_async(char *obj_filename, asset_ready_t on_ready, void *user_data);
+void release_mesh(mesh_t *mesh);
+void load_mesh_obj_data(mesh_t *mesh, const char *obj_data, size_t size);
+void build_mesh_lods(mesh_t *mesh);
+int select_mesh_lod(mesh_t *mesh, int lod, float screen_radius);
+bool is_meshlet_backfacing(meshlet_t *meshlet, vec3_t camera_model_position);
 
 int get_num_meshes(void);
-mesh_t *get_mesh(int index);
+mesh_load_stats_t get_mesh_load_stats(void);
 
 void free_meshes(void);
 
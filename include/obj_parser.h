@@ -0,0 +1,29 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include "triangle.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// files larger than this are split at line ends into chunks parsed on
+// several threads, at most one chunk per logical core
+#define OBJ_MIN_CHUNK_SIZE (128 * 1024)
+#define OBJ_MAX_CHUNKS 8
+
+// parse the v, vt and f lines of OBJ data into dynamic arrays of vertices and
+// triangles; faces may be v, v/vt, v//vn or v/vt/vn with any number of
+// corners (fanned into triangles) and negative relative indices, lines may be
+// of any length. faces with missing indices are skipped with an error.
+// returns the number of chunks the data was parsed in.
+int parse_obj(const char *data, size_t size, vec3_t **vertices, face_t **faces);
+
+// the previous parser, one sscanf() per line copied into a 512 byte buffer and
+// v/vt/vn triangles only; kept to compare results and load times against
+void parse_obj_legacy(const char *data, size_t size, vec3_t **vertices, face_t **faces);
+
+// time both parsers on each file and check they produce the same mesh,
+// printing a line per file (--obj-benchmark file...)
+void benchmark_obj_loaders(int num_paths, char *paths[]);
+
+#endif // !OBJ_PARSER_H
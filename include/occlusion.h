@@ -0,0 +1,22 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "matrix.h"
+#include "mesh.h"
+#include "vector.h"
+#include <stdbool.h>
+
+// low resolution depth buffer of the designated occluders, in camera space z;
+// every value is at or behind the occluder surface, so a mesh whose nearest
+// point is behind every covered pixel of its screen rectangle is hidden
+#define OCCLUSION_BUFFER_DIVISOR 4
+
+void init_occlusion_buffer(int window_width, int window_height, mat4_t proj_matrix);
+void clear_occlusion_buffer(void);
+// with back faces culled the faces the camera is behind are skipped, as the
+// pipeline never draws them and so they hide nothing
+void rasterize_occluder(mesh_t *mesh, mat4_t world_view_matrix, vec3_t camera_model_position, bool is_backface_culled);
+bool is_sphere_occluded(vec3_t center, float radius);
+void free_occlusion_buffer(void);
+
+#endif // !OCCLUSION_H
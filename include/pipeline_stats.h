@@ -0,0 +1,63 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// counters of the work each pipeline stage did, built with PIPELINE_STATS=0
+// to compile every count out of the per-face and per-pixel paths
+#ifndef PIPELINE_STATS
+#define PIPELINE_STATS 1
+#endif
+
+typedef struct
+{
+  // geometry stage, per face of the level of detail drawn
+  uint64_t faces_in;
+  uint64_t faces_backface_culled; // alone or with their whole meshlet
+  uint64_t faces_rejected;        // outside the frustum, alone or with their whole meshlet
+  uint64_t faces_accepted;        // inside the frustum or the guard band, not clipped
+  uint64_t faces_clipped;
+  uint64_t triangles_emitted; // render commands queued, after clipping
+  uint64_t triangles_dropped; // the render queue could not grow, the rest of the instance is dropped
+
+  // raster stage, per pixel covered by a filled or textured triangle
+  uint64_t pixels_tested; // depth tests
+  uint64_t pixels_passed;
+  uint64_t texels_fetched;
+
+  // stage timings, kept without PIPELINE_STATS as they are taken once per frame
+  double transform_ns; // per-face work in the geometry stage, without clipping
+  double cull_ns;      // instance frustum and occlusion culling
+  double clip_ns;
+  double raster_ns;
+} pipeline_counters_t;
+
+// each stage counts into its own set from its own thread; use the macros
+// below instead of touching them
+extern pipeline_counters_t geometry_counters;
+extern pipeline_counters_t raster_counters;
+
+#if PIPELINE_STATS
+#define count_geometry(counter, count) (geometry_counters.counter += (count))
+#define count_raster(counter, count) (raster_counters.counter += (count))
+#else
+#define count_geometry(counter, count) ((void)0)
+#define count_raster(counter, count) ((void)0)
+#endif
+
+// a line with the counters of every frame the raster thread finishes
+void set_pipeline_log(bool is_enabled);
+
+// the geometry stage moves what it counted for a frame into the counters
+// travelling with its render queue, and starts again from zero
+void end_geometry_counters(pipeline_counters_t *frame);
+
+// the raster thread adds what it counted drawing the frame, and the frame
+// to the totals
+void end_raster_counters(pipeline_counters_t *frame);
+
+// totals over every frame drawn, complete once the raster thread is stopped
+pipeline_counters_t get_pipeline_counters(int *num_frames);
+
+#endif // !PIPELINE_STATS_H
@@ -0,0 +1,51 @@
+#ifndef RASTER_THREAD_H
+#define RASTER_THREAD_H
+
+#include "render_queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// two stage frame pipeline: the geometry stage fills one render queue while
+// the raster thread draws the other one into a color buffer, so frame N+1
+// is transformed while frame N is rasterized, one frame later on screen.
+// queues are handed over through an atomic state per queue without locks,
+// finished color buffers through an atomic swap with the present side.
+
+typedef struct
+{
+  double raster_ns_sum;      // time spent drawing queues on the raster thread
+  double raster_idle_ns_sum; // time the raster thread waited for a queue
+  double wait_ns_sum;        // time the geometry stage waited for the raster thread
+  int num_frames;
+  int num_frames_presented;
+  int num_frames_dropped;    // replaced by a newer frame before they were presented
+  int high_water;            // most commands queued in a single frame, over both queues
+  size_t arena_high_water;   // largest frame arena use of either queue
+  size_t arena_capacity;
+} raster_thread_stats_t;
+
+bool start_raster_thread(int queue_capacity);
+
+// queue the geometry stage fills for the next frame, after waiting for the
+// raster thread to finish with it; it belongs to the caller until submit_raster_frame()
+render_queue_t *begin_geometry_frame(void);
+
+// hand the geometry queue to the raster thread with the render method it
+// should be drawn with, and switch the geometry stage to the other queue
+void submit_raster_frame(int render_method);
+
+// color buffer with the newest complete frame, or -1 when nothing was finished
+// since the last call; it stays untouched by the raster thread until the next call
+int acquire_newest_color_buffer(void);
+
+// time the raster thread took for the last frame it finished
+double get_last_raster_ns(void);
+
+// complete once the thread is stopped
+raster_thread_stats_t get_raster_thread_stats(void);
+
+// finishes the frame in flight before the thread exits
+void stop_raster_thread(void);
+
+#endif // !RASTER_THREAD_H
@@ -0,0 +1,25 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "arena.h"
+#include "pipeline_stats.h"
+#include "triangle.h"
+
+// render commands produced by the geometry stage for one frame, allocated from a
+// frame arena that is reset at the start of every frame
+typedef struct
+{
+  arena_t arena;
+  render_command_t *commands;
+  int num_commands;
+  int capacity;
+  int high_water; // most commands queued in a single frame
+  pipeline_counters_t counters; // what the geometry stage, then the raster thread counted for the frame
+} render_queue_t;
+
+void render_queue_init(render_queue_t *queue, int capacity);
+void render_queue_reset(render_queue_t *queue);
+render_command_t *render_queue_push(render_queue_t *queue);
+void render_queue_free(render_queue_t *queue);
+
+#endif // !RENDER_QUEUE_H
@@ -0,0 +1,13 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "triangle.h"
+#include "vector.h"
+
+// reduce faces to about target_num_faces with quadric error edge collapses;
+// open boundaries only move along themselves and collapses never tear UV
+// seams, so outlines and the texture mapping are preserved; returns a new dynamic array of faces indexing the same vertices,
+// NULL when out of memory
+face_t *simplify_faces(vec3_t *vertices, face_t *faces, int target_num_faces);
+
+#endif // !SIMPLIFY_H
@@ -1,6 +1,10 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "asset_loader.h"
+#include "upng.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct
@@ -8,6 +12,85 @@ typedef struct
   float u, v;
 } tex2_t;
 
+// texels of a texture at one resolution; never changed once loaded, so the
+// raster thread samples it while the geometry thread swaps the levels
+typedef struct
+{
+  int width;
+  int height;
+  uint32_t *texels; // width * height texels, owned by png, the cooked file or the level, NULL when compressed
+  upng_t *png;      // NULL when mapped from a cooked file or compressed
+  const unsigned char *cooked_data;
+  size_t cooked_size;
+  bool is_cooked;   // loaded from a cooked file, also once compressed
+  uint64_t *blocks; // BC1 blocks replacing the texels, NULL when not compressed
+  int blocks_per_row;
+} texture_level_t;
+
+typedef struct texture_stream texture_stream_t;
+
+// texture shared by every instance that uses it; the full resolution texels
+// are dropped when they were not drawn for a while and the textures are over
+// the budget, and streamed back in the next time they are drawn
+typedef struct
+{
+  texture_level_t *resident;   // full resolution texels, NULL while evicted
+  texture_level_t placeholder; // a few texels per side, sampled while the texels are not resident
+  char *path;                  // file the texels are streamed back in from
+  uint64_t last_used_frame;
+  texture_stream_t *stream; // stream in flight, NULL when none
+  bool is_unavailable;      // streaming failed, the placeholder is used from then on
+} texture_t;
+
+// textures mapped from cooked files and decoded from PNG files, and the time
+// spent mapping, hashing and decoding their files
+typedef struct
+{
+  int num_cooked;
+  int num_decoded;
+  int num_compressed;
+  double load_ns_sum;
+  double texel_bytes_sum;        // memory the textures sample from
+  double decoded_texel_bytes_sum; // memory they would take as decoded texels
+} texture_load_stats_t;
+
+typedef struct
+{
+  double budget_bytes; // 0 without a budget
+  double resident_bytes;
+  double peak_resident_bytes;
+  double placeholder_bytes; // always resident on top of the budget
+  int num_evicted;
+  int num_streamed_in;
+  int num_uses;
+  int num_placeholder_uses; // uses that drew the placeholder, the texels not being resident
+} texture_residency_stats_t;
+
 tex2_t tex2_clone(tex2_t *t);
 
+// format textures loaded from now on are kept in, see texture_compression.h
+void set_texture_format(int format);
+
+// memory the full resolution texels may take before the least recently drawn
+// are evicted, 0 for no budget; textures drawn in the frames still in flight
+// are never evicted, so the visible textures can go over it
+void set_texture_budget(size_t budget_bytes);
+
+texture_t *load_texture(char *png_filename);
+void load_texture_async(char *png_filename, asset_ready_t on_ready, void *user_data);
+void release_texture(texture_t *texture);
+
+// starts a frame on the geometry thread after the raster thread is done with
+// the frame before the last one, evicting what is over the budget
+void update_texture_residency(void);
+
+// the level to draw the texture with this frame, marking it used and
+// streaming the full resolution texels back in when they were evicted
+const texture_level_t *use_texture(texture_t *texture);
+
+int get_num_textures(void);
+texture_load_stats_t get_texture_load_stats(void);
+texture_residency_stats_t get_texture_residency_stats(void);
+void free_textures(void);
+
 #endif // !TEXTURE_H
@@ -0,0 +1,41 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// how textures are kept in memory after loading
+enum texture_format
+{
+  TEXTURE_FORMAT_RGBA32, // 4 bytes per texel, fetched as is
+  TEXTURE_FORMAT_BC1     // 4x4 texel blocks of 8 bytes, decoded when sampled
+};
+
+// a BC1 block is two RGB565 end colors in the low 32 bits and 2 bit palette
+// indices of its 16 texels in row order above them. with the first end color
+// greater the palette is both ends and two colors a third of the way
+// between them, otherwise both ends, their middle and transparent black
+#define BC1_BLOCK_SIZE 4
+
+bool parse_texture_format(const char *name, int *format);
+
+// blocks of the texture, (width + 3) / 4 per row, with the texels past the
+// right and bottom edges repeating the edge texels; NULL when out of memory
+uint64_t *encode_bc1_blocks(const uint32_t *texels, int width, int height);
+
+// palette of the block sampled last, so the texels after it in the same
+// block only look up their index; one per sampling thread and texture
+typedef struct
+{
+  int block; // -1 before the first texel
+  uint32_t indices;
+  uint32_t palette[4];
+} bc1_block_cache_t;
+
+uint32_t decode_bc1_texel(bc1_block_cache_t *cache, const uint64_t *blocks, int blocks_per_row, int x, int y);
+
+// compare each RGBA PNG file as decoded texels and as BC1 blocks: size, encode
+// time, PSNR and fetch times, a line per file (--texture-benchmark file.png...)
+void benchmark_texture_formats(int num_paths, char *paths[]);
+
+#endif // !TEXTURE_COMPRESSION_H
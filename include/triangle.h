@@ -2,7 +2,7 @@
 #define TRIANGLE_H
 
 #include "texture.h"
-#include "upng.h"
+#include "texture_compression.h"
 #include "vector.h"
 #include <stdint.h>
 
@@ -22,36 +22,41 @@ typedef struct
   vec4_t points[3];
   tex2_t texcoords[3];
   uint32_t color;
-  upng_t *texture;
+  texture_t *texture;
 } triangle_t;
 
+// per-vertex data consumed by the rasterizers: integer screen position and
+// the perspective-correct attributes already divided by w
+typedef struct
+{
+  int x, y;
+  float inv_w;    // 1/w
+  float u_over_w; // u/w
+  float v_over_w; // v/w, with v already flipped for the texture layout
+} raster_vertex_t;
+
+// one entry of the render queue, only what the raster stage needs
+typedef struct
+{
+  raster_vertex_t vertices[3];
+  uint32_t color;
+  const texture_level_t *texture; // level the texture is drawn with this frame
+} render_command_t;
+
 vec3_t get_triangle_normal(vec4_t vertices[3]);
 
 vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p);
 
 void draw_triangle_pixel(
   int x, int y, uint32_t color,
-  vec4_t point_a, vec4_t point_b, vec4_t point_c
-);
-
-void draw_filled_triangle(
-  int x0, int y0, float z0, float w0, // Vertex A
-  int x1, int y1, float z1, float w1, // Vertex B
-  int x2, int y2, float z2, float w2, // Vertex C
-  uint32_t color
+  const raster_vertex_t *a, const raster_vertex_t *b, const raster_vertex_t *c
 );
+void draw_filled_triangle(const render_command_t *command);
 
 void draw_texel(
-  int x, int y, upng_t *texture,
-  vec4_t point_a, vec4_t point_b, vec4_t point_c,
-  tex2_t a_uv, tex2_t b_uv, tex2_t c_uv
-);
-
-void draw_textured_triangle(
-  int x0, int y0, float z0, float w0, float u0, float v0, // vertex A
-  int x1, int y1, float z1, float w1, float u1, float v1, // vertex A
-  int x2, int y2, float z2, float w2, float u2, float v2, // vertex A
-  upng_t *texture
+  int x, int y, const texture_level_t *texture, bc1_block_cache_t *block_cache,
+  const raster_vertex_t *a, const raster_vertex_t *b, const raster_vertex_t *c
 );
+void draw_textured_triangle(const render_command_t *command);
 
 #endif // !TRIANGLE_H
@@ -0,0 +1,36 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include "mesh.h"
+#include "triangle.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// entries of the FIFO cache of transformed vertices the geometry stage keeps,
+// and of the cache the face order is optimized and measured for
+#define VERTEX_CACHE_SIZE 16
+
+// open addressing table finding the welded vertex of a position and UV pair
+typedef struct
+{
+  int *slots; // welded vertex index + 1, 0 for an empty slot
+  int capacity;
+  int num_used;
+} vertex_weld_table_t;
+
+// welded vertex indices of every face corner, three per face, adding the
+// position and UV pairs not in the table yet to the welded vertices
+uint32_t *weld_face_vertices(vertex_weld_table_t *table, mesh_vertex_t **welded_vertices, vec3_t *positions, face_t *faces);
+void free_vertex_weld_table(vertex_weld_table_t *table);
+
+// order of the faces that reuses the most vertices from the cache (Tipsify:
+// fan out around the last vertex, continue with the adjacent vertex still in
+// the cache with the most faces left), face_order gets num_faces face numbers;
+// false when out of memory, face_order then is left untouched
+bool order_faces_for_vertex_cache(const uint32_t *indices, int num_faces, int *face_order);
+
+// vertices transformed per face with the faces drawn in this order
+float get_vertex_cache_miss_ratio(const uint32_t *indices, int num_faces);
+
+#endif // !VERTEX_CACHE_H
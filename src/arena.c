@@ -0,0 +1,134 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(arena_block_t))
+#define ARENA_BLOCK_DATA(block) ((unsigned char *)(block) + ARENA_HEADER_SIZE)
+
+static arena_block_t *arena_block_new(size_t capacity, arena_block_t *previous)
+{
+  arena_block_t *block = (arena_block_t *)malloc(ARENA_HEADER_SIZE + capacity);
+  if (block == NULL)
+  {
+    return NULL;
+  }
+  block->previous = previous;
+  block->capacity = capacity;
+  block->used = 0;
+  return block;
+}
+
+void arena_init(arena_t *arena, size_t capacity)
+{
+  arena->block = arena_block_new(ARENA_ALIGN(capacity), NULL);
+  arena->capacity = arena->block != NULL ? arena->block->capacity : 0;
+  arena->used = 0;
+  arena->high_water = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+  size = ARENA_ALIGN(size);
+
+  arena_block_t *block = arena->block;
+  if (block == NULL || block->used + size > block->capacity)
+  {
+    // grow geometrically; older blocks stay valid until the next reset
+    size_t capacity = block != NULL ? block->capacity * 2 : ARENA_ALIGNMENT;
+    while (capacity < size)
+    {
+      capacity *= 2;
+    }
+
+    block = arena_block_new(capacity, block);
+    if (block == NULL)
+    {
+      return NULL;
+    }
+    arena->block = block;
+    arena->capacity += capacity;
+  }
+
+  void *ptr = ARENA_BLOCK_DATA(block) + block->used;
+  block->used += size;
+  arena->used += size;
+  if (arena->used > arena->high_water)
+  {
+    arena->high_water = arena->used;
+  }
+  return ptr;
+}
+
+void *arena_grow(arena_t *arena, void *ptr, size_t old_size, size_t new_size)
+{
+  if (ptr == NULL)
+  {
+    return arena_alloc(arena, new_size);
+  }
+
+  old_size = ARENA_ALIGN(old_size);
+  new_size = ARENA_ALIGN(new_size);
+
+  // the last allocation of the current block can be extended in place
+  arena_block_t *block = arena->block;
+  if (block != NULL && (unsigned char *)ptr + old_size == ARENA_BLOCK_DATA(block) + block->used && block->used - old_size + new_size <= block->capacity)
+  {
+    block->used += new_size - old_size;
+    arena->used += new_size - old_size;
+    if (arena->used > arena->high_water)
+    {
+      arena->high_water = arena->used;
+    }
+    return ptr;
+  }
+
+  void *new_ptr = arena_alloc(arena, new_size);
+  if (new_ptr != NULL)
+  {
+    memcpy(new_ptr, ptr, old_size);
+  }
+  return new_ptr;
+}
+
+void arena_reset(arena_t *arena)
+{
+  arena_block_t *block = arena->block;
+  if (block != NULL && block->previous != NULL)
+  {
+    // the arena grew during the last frame: merge everything into a single
+    // block so the next frames fit without chaining again
+    while (block != NULL)
+    {
+      arena_block_t *previous = block->previous;
+      free(block);
+      block = previous;
+    }
+    arena->block = arena_block_new(arena->capacity, NULL);
+    if (arena->block == NULL)
+    {
+      arena->capacity = 0;
+    }
+  }
+
+  if (arena->block != NULL)
+  {
+    arena->block->used = 0;
+  }
+  arena->used = 0;
+}
+
+void arena_free(arena_t *arena)
+{
+  arena_block_t *block = arena->block;
+  while (block != NULL)
+  {
+    arena_block_t *previous = block->previous;
+    free(block);
+    block = previous;
+  }
+  arena->block = NULL;
+  arena->capacity = 0;
+  arena->used = 0;
+}
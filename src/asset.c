@@ -0,0 +1,379 @@
+#include "asset.h"
+#include "array.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+uint64_t fnv1a_hash(const void *bytes, size_t size)
+{
+  const unsigned char *data = (const unsigned char *)bytes;
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+bool replace_path_extension(const char *path, const char *extension, char *result, size_t result_size)
+{
+  const char *dot = strrchr(path, '.');
+  const char *separator = strrchr(path, '/');
+  size_t stem_length = strlen(path);
+  if (dot != NULL && (separator == NULL || dot > separator))
+  {
+    stem_length = dot - path;
+  }
+
+  if (stem_length + strlen(extension) + 1 > result_size)
+  {
+    return false;
+  }
+  memcpy(result, path, stem_length);
+  strcpy(result + stem_length, extension);
+  return true;
+}
+
+unsigned char *read_file(const char *path, size_t *size)
+{
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+  {
+    perror("Error opening asset file");
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long length = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  unsigned char *bytes = (unsigned char *)malloc(length > 0 ? length : 1);
+  if (bytes == NULL || length < 0 || fread(bytes, 1, length, fp) != (size_t)length)
+  {
+    fprintf(stderr, "Error: could not read %s.\n", path);
+    free(bytes);
+    fclose(fp);
+    return NULL;
+  }
+
+  fclose(fp);
+  *size = length;
+  return bytes;
+}
+
+#ifdef _WIN32
+
+const unsigned char *map_file(const char *path, size_t *size)
+{
+  return read_file(path, size);
+}
+
+void unmap_file(const unsigned char *bytes, size_t size)
+{
+  (void)size;
+  free((void *)bytes);
+}
+
+#else
+
+// an empty file cannot be mapped, it gets this instead
+static const unsigned char empty_file[1];
+
+const unsigned char *map_file(const char *path, size_t *size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    perror("Error opening asset file");
+    return NULL;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0)
+  {
+    perror("Error reading asset file size");
+    close(fd);
+    return NULL;
+  }
+
+  *size = file_stat.st_size;
+  if (*size == 0)
+  {
+    close(fd);
+    return empty_file;
+  }
+
+  // the mapping stays valid after the descriptor is closed
+  void *bytes = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (bytes == MAP_FAILED)
+  {
+    perror("Error mapping asset file");
+    return NULL;
+  }
+
+  // parsers read it front to back once
+  madvise(bytes, *size, MADV_SEQUENTIAL);
+  return (const unsigned char *)bytes;
+}
+
+void unmap_file(const unsigned char *bytes, size_t size)
+{
+  if (bytes != NULL && size > 0)
+  {
+    munmap((void *)bytes, size);
+  }
+}
+
+#endif
+
+static void add_path(asset_registry_t *registry, const char *path, uint64_t path_hash, int asset)
+{
+  size_t length = strlen(path);
+  asset_path_t entry = {
+    .path = (char *)malloc(length + 1),
+    .path_hash = path_hash,
+    .asset = asset,
+  };
+  memcpy(entry.path, path, length + 1);
+
+  // take the entry of a released path before growing the array
+  for (int i = 0; i < array_length(registry->paths); i++)
+  {
+    if (registry->paths[i].path == NULL)
+    {
+      registry->paths[i] = entry;
+      return;
+    }
+  }
+  array_push(registry->paths, entry);
+}
+
+// index of the asset a path was loaded as, -1 when it has not been
+static int find_path(asset_registry_t *registry, const char *path, uint64_t path_hash)
+{
+  for (int i = 0; i < array_length(registry->paths); i++)
+  {
+    asset_path_t *entry = &registry->paths[i];
+    if (entry->path != NULL && entry->path_hash == path_hash && strcmp(entry->path, path) == 0)
+    {
+      return entry->asset;
+    }
+  }
+  return -1;
+}
+
+// index of the loaded asset decoded from the same bytes, -1 when there is none
+static int find_content(asset_registry_t *registry, uint64_t content_hash, size_t content_size)
+{
+  for (int i = 0; i < array_length(registry->assets); i++)
+  {
+    asset_t *asset = &registry->assets[i];
+    if (asset->data != NULL && asset->content_hash == content_hash && asset->content_size == content_size)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void add_asset(asset_registry_t *registry, const char *path, uint64_t path_hash, uint64_t content_hash, size_t content_size, void *data, uint64_t load_ns)
+{
+  asset_t asset = {
+    .content_hash = content_hash,
+    .content_size = content_size,
+    .data = data,
+    .refcount = 1,
+  };
+
+  // take the entry of a released asset before growing the array
+  int index = -1;
+  for (int i = 0; i < array_length(registry->assets) && index < 0; i++)
+  {
+    if (registry->assets[i].data == NULL)
+    {
+      index = i;
+    }
+  }
+  if (index >= 0)
+  {
+    registry->assets[index] = asset;
+  }
+  else
+  {
+    array_push(registry->assets, asset);
+    index = array_length(registry->assets) - 1;
+  }
+  add_path(registry, path, path_hash, index);
+
+  if (registry->loaded != NULL)
+  {
+    registry->loaded(data, load_ns);
+  }
+}
+
+void *asset_acquire_cached(asset_registry_t *registry, const char *path)
+{
+  int index = find_path(registry, path, fnv1a_hash(path, strlen(path)));
+  if (index < 0)
+  {
+    return NULL;
+  }
+  registry->assets[index].refcount++;
+  return registry->assets[index].data;
+}
+
+void *asset_acquire(asset_registry_t *registry, const char *path)
+{
+  // a path seen before needs no file access at all
+  uint64_t path_hash = fnv1a_hash(path, strlen(path));
+  int index = find_path(registry, path, path_hash);
+  if (index >= 0)
+  {
+    registry->assets[index].refcount++;
+    return registry->assets[index].data;
+  }
+
+  uint64_t start = SDL_GetTicksNS();
+  size_t size;
+  const unsigned char *bytes = map_file(path, &size);
+  if (bytes == NULL)
+  {
+    return NULL;
+  }
+
+  // the same content under another path shares the asset that is already decoded
+  uint64_t content_hash = fnv1a_hash(bytes, size);
+  index = find_content(registry, content_hash, size);
+  if (index >= 0)
+  {
+    unmap_file(bytes, size);
+    add_path(registry, path, path_hash, index);
+    registry->assets[index].refcount++;
+    return registry->assets[index].data;
+  }
+
+  void *data = registry->load(path, bytes, size, content_hash);
+  unmap_file(bytes, size);
+  if (data == NULL)
+  {
+    return NULL;
+  }
+
+  add_asset(registry, path, path_hash, content_hash, size, data, SDL_GetTicksNS() - start);
+  return data;
+}
+
+void *asset_decode(asset_registry_t *registry, const char *path, uint64_t *content_hash, size_t *content_size)
+{
+  size_t size;
+  const unsigned char *bytes = map_file(path, &size);
+  if (bytes == NULL)
+  {
+    return NULL;
+  }
+
+  *content_hash = fnv1a_hash(bytes, size);
+  *content_size = size;
+  void *data = registry->load(path, bytes, size, *content_hash);
+  unmap_file(bytes, size);
+  return data;
+}
+
+void *asset_adopt(asset_registry_t *registry, const char *path, uint64_t content_hash, size_t content_size, void *data, uint64_t load_ns)
+{
+  // another load of the path or of the same bytes may have finished first
+  uint64_t path_hash = fnv1a_hash(path, strlen(path));
+  int index = find_path(registry, path, path_hash);
+  if (index < 0)
+  {
+    index = find_content(registry, content_hash, content_size);
+    if (index >= 0)
+    {
+      add_path(registry, path, path_hash, index);
+    }
+  }
+  if (index >= 0)
+  {
+    registry->free(data);
+    registry->assets[index].refcount++;
+    return registry->assets[index].data;
+  }
+
+  add_asset(registry, path, path_hash, content_hash, content_size, data, load_ns);
+  return data;
+}
+
+void asset_release(asset_registry_t *registry, void *data)
+{
+  if (data == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < array_length(registry->assets); i++)
+  {
+    asset_t *asset = &registry->assets[i];
+    if (asset->data != data)
+      continue;
+
+    if (--asset->refcount > 0)
+    {
+      return;
+    }
+
+    // last reference: free the asset and forget every path that led to it
+    registry->free(asset->data);
+    asset->data = NULL;
+    for (int j = 0; j < array_length(registry->paths); j++)
+    {
+      if (registry->paths[j].asset == i)
+      {
+        free(registry->paths[j].path);
+        registry->paths[j].path = NULL;
+      }
+    }
+    return;
+  }
+}
+
+int asset_count(asset_registry_t *registry)
+{
+  int count = 0;
+  for (int i = 0; i < array_length(registry->assets); i++)
+  {
+    if (registry->assets[i].data != NULL)
+      count++;
+  }
+  return count;
+}
+
+void asset_registry_free(asset_registry_t *registry)
+{
+  for (int i = 0; i < array_length(registry->assets); i++)
+  {
+    if (registry->assets[i].data != NULL)
+    {
+      registry->free(registry->assets[i].data);
+    }
+  }
+  for (int i = 0; i < array_length(registry->paths); i++)
+  {
+    free(registry->paths[i].path);
+  }
+  array_free(registry->assets);
+  array_free(registry->paths);
+  registry->assets = NULL;
+  registry->paths = NULL;
+}
@@ -0,0 +1,268 @@
+#include "asset_loader.h"
+#include "array.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+  asset_ready_t on_ready;
+  void *user_data;
+} asset_waiter_t;
+
+// one file being loaded; the worker writes data, the content and decode_ns
+// before setting is_done, everything else belongs to the requesting thread
+typedef struct
+{
+  asset_registry_t *registry;
+  char *path;
+  asset_waiter_t *waiters; // dynamic array of callbacks for the file
+  void *data;
+  uint64_t content_hash;
+  size_t content_size;
+  uint64_t decode_ns;
+  bool is_adopted; // the registry adopts the data, otherwise the one waiter owns it
+  SDL_AtomicInt is_done;
+} asset_job_t;
+
+static asset_job_t **jobs = NULL; // dynamic array of unfinished jobs, NULL once finished
+
+// jobs no worker has taken yet, guarded by queue_mutex
+static asset_job_t **queue = NULL;
+static int queue_head = 0;
+static bool is_stopping = false;
+static SDL_Mutex *queue_mutex = NULL;
+static SDL_Condition *queue_condition = NULL;
+
+static SDL_Thread *workers[MAX_ASSET_LOADER_THREADS];
+static int num_workers = 0;
+
+static asset_loader_stats_t stats;
+
+static void decode_job(asset_job_t *job)
+{
+  uint64_t start = SDL_GetTicksNS();
+  job->data = asset_decode(job->registry, job->path, &job->content_hash, &job->content_size);
+  job->decode_ns = SDL_GetTicksNS() - start;
+  SDL_SetAtomicInt(&job->is_done, 1);
+}
+
+static int asset_worker_main(void *data)
+{
+  (void)data;
+
+  while (true)
+  {
+    SDL_LockMutex(queue_mutex);
+    while (queue_head == array_length(queue) && !is_stopping)
+    {
+      SDL_WaitCondition(queue_condition, queue_mutex);
+    }
+    if (is_stopping)
+    {
+      SDL_UnlockMutex(queue_mutex);
+      return 0;
+    }
+
+    asset_job_t *job = queue[queue_head++];
+    if (queue_head == array_length(queue))
+    {
+      array_clear(queue);
+      queue_head = 0;
+    }
+    SDL_UnlockMutex(queue_mutex);
+
+    decode_job(job);
+  }
+}
+
+void start_asset_loader(void)
+{
+  stats = (asset_loader_stats_t){0};
+  is_stopping = false;
+  queue_mutex = SDL_CreateMutex();
+  queue_condition = SDL_CreateCondition();
+  if (queue_mutex == NULL || queue_condition == NULL)
+  {
+    fprintf(stderr, "Error: could not create the asset loader queue: %s.\n", SDL_GetError());
+    return;
+  }
+
+  // leave a core to the threads that are already busy
+  int num_threads = SDL_GetNumLogicalCPUCores() - 1;
+  num_threads = num_threads < 1 ? 1 : (num_threads > MAX_ASSET_LOADER_THREADS ? MAX_ASSET_LOADER_THREADS : num_threads);
+  for (num_workers = 0; num_workers < num_threads; num_workers++)
+  {
+    workers[num_workers] = SDL_CreateThread(asset_worker_main, "asset loader", NULL);
+    if (workers[num_workers] == NULL)
+    {
+      fprintf(stderr, "Error: SDL_CreateThread(): %s.\n", SDL_GetError());
+      break;
+    }
+  }
+  stats.num_threads = num_workers;
+}
+
+static void queue_asset_job(asset_registry_t *registry, const char *path, asset_waiter_t waiter, bool is_adopted)
+{
+  if (stats.first_request_ns == 0)
+  {
+    stats.first_request_ns = SDL_GetTicksNS();
+  }
+
+  asset_job_t *job = (asset_job_t *)calloc(1, sizeof(asset_job_t));
+  size_t length = strlen(path);
+  char *path_copy = (char *)malloc(length + 1);
+  if (job == NULL || path_copy == NULL)
+  {
+    free(job);
+    free(path_copy);
+    waiter.on_ready(NULL, waiter.user_data);
+    return;
+  }
+  memcpy(path_copy, path, length + 1);
+  job->path = path_copy;
+  job->registry = registry;
+  job->is_adopted = is_adopted;
+  array_push(job->waiters, waiter);
+  array_push(jobs, job);
+
+  if (num_workers == 0)
+  {
+    decode_job(job);
+    return;
+  }
+
+  SDL_LockMutex(queue_mutex);
+  array_push(queue, job);
+  SDL_SignalCondition(queue_condition);
+  SDL_UnlockMutex(queue_mutex);
+}
+
+void load_asset_async(asset_registry_t *registry, const char *path, asset_ready_t on_ready, void *user_data)
+{
+  void *data = asset_acquire_cached(registry, path);
+  if (data != NULL)
+  {
+    on_ready(data, user_data);
+    return;
+  }
+
+  asset_waiter_t waiter = {on_ready, user_data};
+  for (int i = 0; i < array_length(jobs); i++)
+  {
+    if (jobs[i] != NULL && jobs[i]->is_adopted && jobs[i]->registry == registry && strcmp(jobs[i]->path, path) == 0)
+    {
+      array_push(jobs[i]->waiters, waiter);
+      return;
+    }
+  }
+  queue_asset_job(registry, path, waiter, true);
+}
+
+void decode_asset_async(asset_registry_t *registry, const char *path, asset_ready_t on_ready, void *user_data)
+{
+  queue_asset_job(registry, path, (asset_waiter_t){on_ready, user_data}, false);
+}
+
+static void free_job(asset_job_t *job)
+{
+  array_free(job->waiters);
+  free(job->path);
+  free(job);
+}
+
+int finish_asset_loads(void)
+{
+  int num_loading = 0;
+  for (int i = 0; i < array_length(jobs); i++)
+  {
+    asset_job_t *job = jobs[i];
+    if (job == NULL)
+      continue;
+
+    if (!SDL_GetAtomicInt(&job->is_done))
+    {
+      num_loading++;
+      continue;
+    }
+
+    void *data = job->data;
+    if (job->data != NULL)
+    {
+      if (job->is_adopted)
+      {
+        data = asset_adopt(job->registry, job->path, job->content_hash, job->content_size, job->data, job->decode_ns);
+      }
+      stats.num_loaded++;
+      stats.decode_ns_sum += job->decode_ns;
+    }
+    else
+    {
+      stats.num_failed++;
+    }
+
+    // the adopted reference goes to the first callback, every other one gets its own
+    for (int j = 0; j < array_length(job->waiters); j++)
+    {
+      void *reference = j == 0 || data == NULL ? data : asset_acquire_cached(job->registry, job->path);
+      job->waiters[j].on_ready(reference, job->waiters[j].user_data);
+    }
+    stats.last_ready_ns = SDL_GetTicksNS();
+
+    free_job(job);
+    jobs[i] = NULL;
+  }
+
+  if (num_loading == 0)
+  {
+    array_clear(jobs);
+  }
+  return num_loading;
+}
+
+asset_loader_stats_t get_asset_loader_stats(void)
+{
+  return stats;
+}
+
+void stop_asset_loader(void)
+{
+  if (queue_mutex != NULL)
+  {
+    SDL_LockMutex(queue_mutex);
+    is_stopping = true;
+    SDL_BroadcastCondition(queue_condition);
+    SDL_UnlockMutex(queue_mutex);
+  }
+  for (int i = 0; i < num_workers; i++)
+  {
+    SDL_WaitThread(workers[i], NULL);
+  }
+  num_workers = 0;
+
+  // every worker is gone, so the jobs it did not finish are not touched anymore
+  for (int i = 0; i < array_length(jobs); i++)
+  {
+    if (jobs[i] != NULL)
+    {
+      if (SDL_GetAtomicInt(&jobs[i]->is_done) && jobs[i]->data != NULL)
+      {
+        jobs[i]->registry->free(jobs[i]->data);
+      }
+      free_job(jobs[i]);
+    }
+  }
+  array_free(jobs);
+  array_free(queue);
+  jobs = NULL;
+  queue = NULL;
+  queue_head = 0;
+
+  SDL_DestroyCondition(queue_condition);
+  SDL_DestroyMutex(queue_mutex);
+  queue_condition = NULL;
+  queue_mutex = NULL;
+}
@@ -0,0 +1,278 @@
+#include "benchmark.h"
+#include "array.h"
+#include "asset_loader.h"
+#include "instance.h"
+#include "matrix.h"
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the orbit keeps this many radii from the center, the dolly starts this far
+// and ends this far inside the bounds
+#define BENCHMARK_ORBIT_DISTANCE 2.0
+#define BENCHMARK_DOLLY_START 3.0
+#define BENCHMARK_DOLLY_END 0.25
+
+// angle in radians the camera looks down on the scene from
+#define BENCHMARK_CAMERA_ELEVATION 0.4
+
+// sleep between checks whether the scene finished loading
+#define BENCHMARK_LOAD_POLL_NS 250000
+
+static const char *path_names[] = {"orbit", "dolly"};
+static const char *stage_names[] = {"transform", "cull", "clip", "raster", "present"};
+
+static double *stage_samples_ns[NUM_BENCHMARK_STAGES] = {NULL};
+static SDL_AtomicInt is_recording;
+
+bool parse_benchmark_path(const char *name, int *path)
+{
+  for (int i = 0; i < (int)(sizeof(path_names) / sizeof(path_names[0])); i++)
+  {
+    if (strcmp(name, path_names[i]) == 0)
+    {
+      *path = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *get_benchmark_path_name(int path)
+{
+  return path_names[path];
+}
+
+const char *get_benchmark_stage_name(int stage)
+{
+  return stage_names[stage];
+}
+
+camera_t get_benchmark_camera(int path, vec3_t center, float radius, int frame, int num_frames)
+{
+  float t = num_frames > 1 ? (float)frame / (num_frames - 1) : 0;
+  camera_t camera = {0};
+  switch (path)
+  {
+  case BENCHMARK_PATH_ORBIT:
+  {
+    // starts in front of the scene, where the interactive camera looks from
+    float angle = t * 2 * M_PI;
+    vec3_t offset = vec3_new(sinf(angle) * cosf(BENCHMARK_CAMERA_ELEVATION), sinf(BENCHMARK_CAMERA_ELEVATION), -cosf(angle) * cosf(BENCHMARK_CAMERA_ELEVATION));
+    camera.position = vec3_add(center, vec3_mul(offset, BENCHMARK_ORBIT_DISTANCE * radius));
+    break;
+  }
+  case BENCHMARK_PATH_DOLLY:
+  {
+    float distance = BENCHMARK_DOLLY_START + (BENCHMARK_DOLLY_END - BENCHMARK_DOLLY_START) * t;
+    vec3_t offset = vec3_new(0, sinf(BENCHMARK_CAMERA_ELEVATION), -cosf(BENCHMARK_CAMERA_ELEVATION));
+    camera.position = vec3_add(center, vec3_mul(offset, distance * radius));
+    break;
+  }
+  }
+  camera.direction = vec3_sub(center, camera.position);
+  vec3_normalize(&camera.direction);
+  return camera;
+}
+
+// sphere around the world bounds of every instance, centered on their box
+static void get_scene_bounds(vec3_t *center, float *radius)
+{
+  *center = vec3_new(0, 0, 0);
+  *radius = 1;
+  if (get_num_instances() == 0)
+  {
+    return;
+  }
+
+  instance_t *instances = get_instances();
+  vec3_t *centers = (vec3_t *)malloc(sizeof(vec3_t) * get_num_instances());
+  float *radii = (float *)malloc(sizeof(float) * get_num_instances());
+  if (centers == NULL || radii == NULL)
+  {
+    free(centers);
+    free(radii);
+    return;
+  }
+
+  vec3_t min = vec3_new(INFINITY, INFINITY, INFINITY);
+  vec3_t max = vec3_new(-INFINITY, -INFINITY, -INFINITY);
+  for (int i = 0; i < get_num_instances(); i++)
+  {
+    instance_t *instance = &instances[i];
+    mat4_t instance_matrix = mat4_make_world(instance->scale, instance->rotation, instance->translation);
+    float max_scale = fmaxf(fabsf(instance->scale.x), fmaxf(fabsf(instance->scale.y), fabsf(instance->scale.z)));
+    centers[i] = vec3_from_vec4(mat4_mul_vec4(instance_matrix, vec4_from_vec3(instance->mesh->bounds_center)));
+    radii[i] = instance->mesh->bounds_radius * max_scale;
+    min = vec3_new(fminf(min.x, centers[i].x - radii[i]), fminf(min.y, centers[i].y - radii[i]), fminf(min.z, centers[i].z - radii[i]));
+    max = vec3_new(fmaxf(max.x, centers[i].x + radii[i]), fmaxf(max.y, centers[i].y + radii[i]), fmaxf(max.z, centers[i].z + radii[i]));
+  }
+
+  *center = vec3_mul(vec3_add(min, max), 0.5);
+  *radius = 0;
+  for (int i = 0; i < get_num_instances(); i++)
+  {
+    *radius = fmaxf(*radius, vec3_length(vec3_sub(centers[i], *center)) + radii[i]);
+  }
+  free(centers);
+  free(radii);
+}
+
+// wait for the scene to load, then draw the frames along the camera path;
+// frames are not paced and the camera ignores input
+void run_benchmark(int path, int num_frames, benchmark_frame_t draw_frame, SDL_AtomicInt *is_running)
+{
+  while (finish_asset_loads() > 0 && SDL_GetAtomicInt(is_running))
+  {
+    SDL_DelayNS(BENCHMARK_LOAD_POLL_NS);
+  }
+
+  vec3_t center;
+  float radius;
+  get_scene_bounds(&center, &radius);
+
+  start_benchmark_recording();
+  for (int frame = 0; frame < num_frames && SDL_GetAtomicInt(is_running); frame++)
+  {
+    draw_frame(get_benchmark_camera(path, center, radius, frame, num_frames));
+  }
+}
+
+void start_benchmark_recording(void)
+{
+  for (int stage = 0; stage < NUM_BENCHMARK_STAGES; stage++)
+  {
+    array_clear(stage_samples_ns[stage]);
+  }
+  SDL_SetAtomicInt(&is_recording, 1);
+}
+
+void stop_benchmark_recording(void)
+{
+  SDL_SetAtomicInt(&is_recording, 0);
+}
+
+void record_benchmark_sample(int stage, double ns)
+{
+  if (SDL_GetAtomicInt(&is_recording))
+  {
+    array_push(stage_samples_ns[stage], ns);
+  }
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+benchmark_stage_stats_t get_benchmark_stage_stats(int stage)
+{
+  benchmark_stage_stats_t stats = {0};
+  int num_samples = array_length(stage_samples_ns[stage]);
+  stats.num_samples = num_samples;
+  if (num_samples == 0)
+  {
+    return stats;
+  }
+
+  double *sorted = malloc(sizeof(double) * num_samples);
+  if (sorted == NULL)
+  {
+    return stats;
+  }
+  memcpy(sorted, stage_samples_ns[stage], sizeof(double) * num_samples);
+  qsort(sorted, num_samples, sizeof(double), compare_doubles);
+
+  double sum = 0;
+  for (int i = 0; i < num_samples; i++)
+  {
+    sum += sorted[i];
+  }
+  stats.mean_ms = sum / num_samples / 1e6;
+  stats.p50_ms = sorted[num_samples / 2] / 1e6;
+  stats.p99_ms = sorted[(int)((num_samples - 1) * 0.99)] / 1e6;
+
+  free(sorted);
+  return stats;
+}
+
+void report_benchmark(const benchmark_run_t *run, const char *json_path)
+{
+  printf(
+    "benchmark: %s, %d instances, %s path, %dx%d, %s, %d frames\n",
+    run->scene,
+    run->num_instances,
+    get_benchmark_path_name(run->path),
+    run->width,
+    run->height,
+    run->render_method,
+    run->num_frames
+  );
+  for (int stage = 0; stage < NUM_BENCHMARK_STAGES; stage++)
+  {
+    benchmark_stage_stats_t stats = get_benchmark_stage_stats(stage);
+    printf(
+      "  %-9s mean %8.3f ms, p50 %8.3f ms, p99 %8.3f ms over %d frames\n",
+      get_benchmark_stage_name(stage),
+      stats.mean_ms,
+      stats.p50_ms,
+      stats.p99_ms,
+      stats.num_samples
+    );
+  }
+
+  if (json_path == NULL)
+  {
+    return;
+  }
+
+  FILE *fp = fopen(json_path, "a");
+  if (fp == NULL)
+  {
+    perror("Error opening benchmark JSON file");
+    return;
+  }
+  fprintf(
+    fp,
+    "{\"scene\": \"%s\", \"instances\": %d, \"path\": \"%s\", \"width\": %d, \"height\": %d, \"render_method\": \"%s\", \"frames\": %d, \"stages\": {",
+    run->scene,
+    run->num_instances,
+    get_benchmark_path_name(run->path),
+    run->width,
+    run->height,
+    run->render_method,
+    run->num_frames
+  );
+  for (int stage = 0; stage < NUM_BENCHMARK_STAGES; stage++)
+  {
+    benchmark_stage_stats_t stats = get_benchmark_stage_stats(stage);
+    fprintf(
+      fp,
+      "%s\"%s\": {\"samples\": %d, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p99_ms\": %.6f}",
+      stage > 0 ? ", " : "",
+      get_benchmark_stage_name(stage),
+      stats.num_samples,
+      stats.mean_ms,
+      stats.p50_ms,
+      stats.p99_ms
+    );
+  }
+  fprintf(fp, "}}\n");
+  if (fclose(fp) != 0)
+  {
+    fprintf(stderr, "Error: could not write %s.\n", json_path);
+  }
+}
+
+void free_benchmark(void)
+{
+  for (int stage = 0; stage < NUM_BENCHMARK_STAGES; stage++)
+  {
+    array_free(stage_samples_ns[stage]);
+    stage_samples_ns[stage] = NULL;
+  }
+}
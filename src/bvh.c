@@ -0,0 +1,433 @@
+#include "bvh.h"
+#include "array.h"
+#include "clipping.h"
+#include "vector.h"
+#include <math.h>
+#include <stdlib.h>
+
+// deep enough for any tree built by median splits
+#define BVH_MAX_STACK_DEPTH 64
+
+typedef struct
+{
+  float key;
+  int item;
+} bvh_sort_entry_t;
+
+aabb_t aabb_empty(void)
+{
+  aabb_t box = {
+    .min = vec3_new(INFINITY, INFINITY, INFINITY),
+    .max = vec3_new(-INFINITY, -INFINITY, -INFINITY),
+  };
+  return box;
+}
+
+bool aabb_is_empty(aabb_t box)
+{
+  return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+}
+
+aabb_t aabb_from_sphere(vec3_t center, float radius)
+{
+  aabb_t box = {
+    .min = vec3_new(center.x - radius, center.y - radius, center.z - radius),
+    .max = vec3_new(center.x + radius, center.y + radius, center.z + radius),
+  };
+  return box;
+}
+
+aabb_t aabb_union(aabb_t a, aabb_t b)
+{
+  aabb_t box = {
+    .min = vec3_new(fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z)),
+    .max = vec3_new(fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z)),
+  };
+  return box;
+}
+
+bool aabb_overlaps(aabb_t a, aabb_t b)
+{
+  return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+         a.min.y <= b.max.y && a.max.y >= b.min.y &&
+         a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static bool aabb_equals(aabb_t a, aabb_t b)
+{
+  return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+         a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+}
+
+static int compare_sort_entries(const void *a, const void *b)
+{
+  float key_a = ((const bvh_sort_entry_t *)a)->key;
+  float key_b = ((const bvh_sort_entry_t *)b)->key;
+  return (key_a > key_b) - (key_a < key_b);
+}
+
+static aabb_t leaf_bounds(bvh_t *bvh, bvh_node_t *node)
+{
+  aabb_t bounds = bvh->item_bounds[bvh->items[node->first_item]];
+  for (int i = node->first_item + 1; i < node->first_item + node->num_items; i++)
+  {
+    bounds = aabb_union(bounds, bvh->item_bounds[bvh->items[i]]);
+  }
+  return bounds;
+}
+
+// build the subtree over items[first, first + count) and return its node index
+static int build_node(bvh_t *bvh, bvh_sort_entry_t *entries, int first, int count, int parent)
+{
+  bvh_node_t node = {
+    .parent = parent,
+    .left = -1,
+    .right = -1,
+    .first_item = first,
+    .num_items = count,
+  };
+  int index = array_length(bvh->nodes);
+  array_push(bvh->nodes, node);
+
+  if (count <= BVH_MAX_LEAF_ITEMS)
+  {
+    for (int i = first; i < first + count; i++)
+    {
+      bvh->item_leaves[bvh->items[i]] = index;
+    }
+    bvh->nodes[index].bounds = leaf_bounds(bvh, &bvh->nodes[index]);
+    return index;
+  }
+
+  // split at the median item centroid along the widest axis of the centroids
+  aabb_t centroid_bounds = aabb_empty();
+  for (int i = first; i < first + count; i++)
+  {
+    aabb_t bounds = bvh->item_bounds[bvh->items[i]];
+    if (aabb_is_empty(bounds))
+      continue;
+    vec3_t centroid = vec3_mul(vec3_add(bounds.min, bounds.max), 0.5);
+    aabb_t point = {centroid, centroid};
+    centroid_bounds = aabb_union(centroid_bounds, point);
+  }
+  vec3_t extent = vec3_sub(centroid_bounds.max, centroid_bounds.min);
+  int axis = 0;
+  if (extent.y > extent.x)
+    axis = 1;
+  if (extent.z > (axis == 0 ? extent.x : extent.y))
+    axis = 2;
+
+  for (int i = first; i < first + count; i++)
+  {
+    aabb_t bounds = bvh->item_bounds[bvh->items[i]];
+    if (aabb_is_empty(bounds))
+    {
+      entries[i] = (bvh_sort_entry_t){INFINITY, bvh->items[i]};
+      continue;
+    }
+    float min = axis == 0 ? bounds.min.x : (axis == 1 ? bounds.min.y : bounds.min.z);
+    float max = axis == 0 ? bounds.max.x : (axis == 1 ? bounds.max.y : bounds.max.z);
+    entries[i] = (bvh_sort_entry_t){min + max, bvh->items[i]};
+  }
+  qsort(&entries[first], count, sizeof(bvh_sort_entry_t), compare_sort_entries);
+  for (int i = first; i < first + count; i++)
+  {
+    bvh->items[i] = entries[i].item;
+  }
+
+  // the node array may move while children are added, so index it again afterwards
+  int half = count / 2;
+  int left = build_node(bvh, entries, first, half, index);
+  int right = build_node(bvh, entries, first + half, count - half, index);
+  bvh->nodes[index].left = left;
+  bvh->nodes[index].right = right;
+  bvh->nodes[index].bounds = aabb_union(bvh->nodes[left].bounds, bvh->nodes[right].bounds);
+  return index;
+}
+
+void bvh_build(bvh_t *bvh, aabb_t *item_bounds, int num_items)
+{
+  bvh_free(bvh);
+  if (num_items == 0)
+  {
+    return;
+  }
+
+  bvh->items = array_hold(NULL, num_items, sizeof(int));
+  bvh->item_bounds = array_hold(NULL, num_items, sizeof(aabb_t));
+  bvh->item_leaves = array_hold(NULL, num_items, sizeof(int));
+  for (int i = 0; i < num_items; i++)
+  {
+    bvh->items[i] = i;
+    bvh->item_bounds[i] = item_bounds[i];
+  }
+
+  bvh_sort_entry_t *entries = (bvh_sort_entry_t *)malloc(sizeof(bvh_sort_entry_t) * num_items);
+  build_node(bvh, entries, 0, num_items, -1);
+  free(entries);
+}
+
+void bvh_set_item_bounds(bvh_t *bvh, int item, aabb_t bounds)
+{
+  if (aabb_equals(bvh->item_bounds[item], bounds))
+  {
+    return;
+  }
+
+  bvh->item_bounds[item] = bounds;
+  int leaf = bvh->item_leaves[item];
+  if (!bvh->nodes[leaf].is_dirty)
+  {
+    bvh->nodes[leaf].is_dirty = true;
+    array_push(bvh->dirty_leaves, leaf);
+  }
+}
+
+void bvh_refit(bvh_t *bvh)
+{
+  // walk up from every moved leaf until a node's bounds no longer change
+  for (int i = 0; i < array_length(bvh->dirty_leaves); i++)
+  {
+    int index = bvh->dirty_leaves[i];
+    bvh_node_t *node = &bvh->nodes[index];
+    node->is_dirty = false;
+    node->bounds = leaf_bounds(bvh, node);
+
+    for (index = node->parent; index >= 0; index = bvh->nodes[index].parent)
+    {
+      bvh_node_t *parent = &bvh->nodes[index];
+      aabb_t bounds = aabb_union(bvh->nodes[parent->left].bounds, bvh->nodes[parent->right].bounds);
+      if (aabb_equals(parent->bounds, bounds))
+      {
+        break;
+      }
+      parent->bounds = bounds;
+    }
+  }
+  array_clear(bvh->dirty_leaves);
+}
+
+static float aabb_surface_area(aabb_t box)
+{
+  if (aabb_is_empty(box))
+  {
+    return 0;
+  }
+  vec3_t size = vec3_sub(box.max, box.min);
+  return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+float bvh_get_cost(bvh_t *bvh)
+{
+  if (array_length(bvh->nodes) == 0)
+  {
+    return 0;
+  }
+
+  float root_area = aabb_surface_area(bvh->nodes[0].bounds);
+  if (root_area <= 0)
+  {
+    return 0;
+  }
+
+  float area_sum = 0;
+  for (int i = 0; i < array_length(bvh->nodes); i++)
+  {
+    area_sum += aabb_surface_area(bvh->nodes[i].bounds);
+  }
+  return area_sum / root_area;
+}
+
+static void push_subtree_items(bvh_t *bvh, int index, int **items)
+{
+  bvh_node_t *node = &bvh->nodes[index];
+  if (node->left < 0)
+  {
+    for (int i = node->first_item; i < node->first_item + node->num_items; i++)
+    {
+      if (!aabb_is_empty(bvh->item_bounds[bvh->items[i]]))
+        array_push(*items, bvh->items[i]);
+    }
+    return;
+  }
+  push_subtree_items(bvh, node->left, items);
+  push_subtree_items(bvh, node->right, items);
+}
+
+// test a box against the planes selected by plane_mask; planes the box is
+// completely inside of are removed from the mask, as its contents are too
+static bool is_box_outside_planes(aabb_t box, plane_t planes[NUM_PLANES], int *plane_mask)
+{
+  if (aabb_is_empty(box))
+  {
+    return true;
+  }
+
+  vec3_t center = vec3_mul(vec3_add(box.min, box.max), 0.5);
+  vec3_t half_extent = vec3_mul(vec3_sub(box.max, box.min), 0.5);
+
+  for (int plane = 0; plane < NUM_PLANES; plane++)
+  {
+    if (!(*plane_mask & (1 << plane)))
+      continue;
+
+    // signed distance of the box center and the box "radius" along the plane normal
+    vec3_t normal = planes[plane].normal;
+    float distance = vec3_dot(vec3_sub(center, planes[plane].point), normal);
+    float radius = half_extent.x * fabsf(normal.x) + half_extent.y * fabsf(normal.y) + half_extent.z * fabsf(normal.z);
+    if (distance < -radius)
+    {
+      return true;
+    }
+    if (distance >= radius)
+    {
+      *plane_mask &= ~(1 << plane);
+    }
+  }
+  return false;
+}
+
+static void query_frustum_node(bvh_t *bvh, int index, plane_t planes[NUM_PLANES], int plane_mask, int **items)
+{
+  bvh_node_t *node = &bvh->nodes[index];
+  if (is_box_outside_planes(node->bounds, planes, &plane_mask))
+  {
+    return;
+  }
+
+  if (plane_mask == 0)
+  {
+    push_subtree_items(bvh, index, items); // completely inside the frustum
+  }
+  else if (node->left < 0)
+  {
+    for (int i = node->first_item; i < node->first_item + node->num_items; i++)
+    {
+      int item_plane_mask = plane_mask;
+      if (!is_box_outside_planes(bvh->item_bounds[bvh->items[i]], planes, &item_plane_mask))
+        array_push(*items, bvh->items[i]);
+    }
+  }
+  else
+  {
+    query_frustum_node(bvh, node->left, planes, plane_mask, items);
+    query_frustum_node(bvh, node->right, planes, plane_mask, items);
+  }
+}
+
+void bvh_query_frustum(bvh_t *bvh, plane_t planes[NUM_PLANES], int **items)
+{
+  if (array_length(bvh->nodes) > 0)
+  {
+    query_frustum_node(bvh, 0, planes, (1 << NUM_PLANES) - 1, items);
+  }
+}
+
+void bvh_query_box(bvh_t *bvh, aabb_t box, int **items)
+{
+  if (array_length(bvh->nodes) == 0)
+  {
+    return;
+  }
+
+  int stack[BVH_MAX_STACK_DEPTH];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0)
+  {
+    bvh_node_t *node = &bvh->nodes[stack[--stack_size]];
+    if (!aabb_overlaps(node->bounds, box))
+      continue;
+
+    if (node->left < 0)
+    {
+      for (int i = node->first_item; i < node->first_item + node->num_items; i++)
+      {
+        if (aabb_overlaps(bvh->item_bounds[bvh->items[i]], box))
+          array_push(*items, bvh->items[i]);
+      }
+    }
+    else if (stack_size + 2 <= BVH_MAX_STACK_DEPTH)
+    {
+      stack[stack_size++] = node->right;
+      stack[stack_size++] = node->left;
+    }
+  }
+}
+
+// slab test, returns the distance along the ray where it enters the box or INFINITY
+static float ray_box_distance(aabb_t box, vec3_t origin, vec3_t inv_direction, float max_distance)
+{
+  if (aabb_is_empty(box))
+  {
+    return INFINITY;
+  }
+
+  float t1 = (box.min.x - origin.x) * inv_direction.x;
+  float t2 = (box.max.x - origin.x) * inv_direction.x;
+  float t_min = fminf(t1, t2);
+  float t_max = fmaxf(t1, t2);
+
+  t1 = (box.min.y - origin.y) * inv_direction.y;
+  t2 = (box.max.y - origin.y) * inv_direction.y;
+  t_min = fmaxf(t_min, fminf(t1, t2));
+  t_max = fminf(t_max, fmaxf(t1, t2));
+
+  t1 = (box.min.z - origin.z) * inv_direction.z;
+  t2 = (box.max.z - origin.z) * inv_direction.z;
+  t_min = fmaxf(t_min, fminf(t1, t2));
+  t_max = fminf(t_max, fmaxf(t1, t2));
+
+  if (t_max < fmaxf(t_min, 0) || t_min > max_distance)
+  {
+    return INFINITY;
+  }
+  return fmaxf(t_min, 0);
+}
+
+void bvh_query_ray(bvh_t *bvh, vec3_t origin, vec3_t direction, float max_distance, int **items)
+{
+  if (array_length(bvh->nodes) == 0)
+  {
+    return;
+  }
+
+  vec3_t inv_direction = vec3_new(1.0 / direction.x, 1.0 / direction.y, 1.0 / direction.z);
+
+  // visit the nearer child first, so items come out roughly front to back
+  int stack[BVH_MAX_STACK_DEPTH];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0)
+  {
+    bvh_node_t *node = &bvh->nodes[stack[--stack_size]];
+    if (node->left < 0)
+    {
+      for (int i = node->first_item; i < node->first_item + node->num_items; i++)
+      {
+        if (ray_box_distance(bvh->item_bounds[bvh->items[i]], origin, inv_direction, max_distance) != INFINITY)
+          array_push(*items, bvh->items[i]);
+      }
+      continue;
+    }
+
+    float left = ray_box_distance(bvh->nodes[node->left].bounds, origin, inv_direction, max_distance);
+    float right = ray_box_distance(bvh->nodes[node->right].bounds, origin, inv_direction, max_distance);
+    int near = left <= right ? node->left : node->right;
+    int far = left <= right ? node->right : node->left;
+    if (fmaxf(left, right) != INFINITY && stack_size < BVH_MAX_STACK_DEPTH)
+      stack[stack_size++] = far;
+    if (fminf(left, right) != INFINITY && stack_size < BVH_MAX_STACK_DEPTH)
+      stack[stack_size++] = near;
+  }
+}
+
+void bvh_free(bvh_t *bvh)
+{
+  array_free(bvh->nodes);
+  array_free(bvh->items);
+  array_free(bvh->item_bounds);
+  array_free(bvh->item_leaves);
+  array_free(bvh->dirty_leaves);
+  *bvh = (bvh_t){0};
+}
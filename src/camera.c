@@ -4,6 +4,23 @@
 
 static camera_t camera;
 
+// unit vector the camera looks along, from the positive z-axis turned by pitch, then yaw
+static vec3_t direction_from_angles(float yaw, float pitch)
+{
+  // initialize the target looking at the position z-axis
+  vec3_t target = {0, 0, 1};
+
+  mat4_t camera_yaw_rotation = mat4_make_rotation_y(yaw);
+  mat4_t camera_pitch_rotation = mat4_make_rotation_x(pitch);
+
+  // create camera rotation matrix based on yaw and pitch
+  mat4_t camera_rotation = mat4_identity();
+  camera_rotation = mat4_mul_mat4(camera_pitch_rotation, camera_rotation);
+  camera_rotation = mat4_mul_mat4(camera_yaw_rotation, camera_rotation);
+
+  return vec3_from_vec4(mat4_mul_vec4(camera_rotation, vec4_from_vec3(target)));
+}
+
 void init_camera(vec3_t position, vec3_t direction)
 {
   camera.position = position;
@@ -56,32 +73,37 @@ void update_camera_forward_velocity(vec3_t forward_velocity)
 void rotate_camera_yaw(float angle)
 {
   camera.yaw += angle;
+  camera.direction = direction_from_angles(camera.yaw, camera.pitch);
 }
 
 void rotate_camera_pitch(float angle)
 {
   camera.pitch += angle;
+  camera.direction = direction_from_angles(camera.yaw, camera.pitch);
 }
 
 vec3_t get_camera_lookat_target(void)
 {
-  // initialize the target looking at the position z-axis
-  vec3_t target = {0, 0, 1};
-
-  mat4_t camera_yaw_rotation = mat4_make_rotation_y(camera.yaw);
-  mat4_t camera_pitch_rotation = mat4_make_rotation_x(camera.pitch);
-
-  // create camera rotation matrix based on yaw and pitch
-  mat4_t camera_rotation = mat4_identity();
-  camera_rotation = mat4_mul_mat4(camera_pitch_rotation, camera_rotation);
-  camera_rotation = mat4_mul_mat4(camera_yaw_rotation, camera_rotation);
-
   // update camera direction based on the rotation
-  vec4_t camera_direction = mat4_mul_vec4(camera_rotation, vec4_from_vec3(target));
-  camera.direction = vec3_from_vec4(camera_direction);
+  camera.direction = direction_from_angles(camera.yaw, camera.pitch);
 
   // offset the camera position in the direction where the camera is pointing at
-  target = vec3_add(camera.position, camera.direction);
+  vec3_t target = vec3_add(camera.position, camera.direction);
 
   return target;
 }
+
+camera_t get_camera(void)
+{
+  return camera;
+}
+
+camera_t interpolate_camera(camera_t from, camera_t to, float t)
+{
+  camera_t result = to;
+  result.position = vec3_add(from.position, vec3_mul(vec3_sub(to.position, from.position), t));
+  result.yaw = from.yaw + (to.yaw - from.yaw) * t;
+  result.pitch = from.pitch + (to.pitch - from.pitch) * t;
+  result.direction = direction_from_angles(result.yaw, result.pitch);
+  return result;
+}
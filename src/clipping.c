@@ -1,11 +1,29 @@
 #include "clipping.h"
+#include "pipeline_stats.h"
 #include "texture.h"
 #include "vector.h"
 #include <math.h>
+#include <stdbool.h>
 
-#define NUM_PLANES 6
 plane_t frustum_planes[NUM_PLANES];
 
+// side planes widened by GUARD_BAND_FACTOR; anything between these and the
+// real side planes is left for the rasterizer scissor instead of being clipped
+#define GUARD_BAND_FACTOR 4.0
+plane_t guard_band_planes[NUM_PLANES];
+
+int clip_method = CLIP_GUARD_BAND;
+
+void set_clip_method(int method)
+{
+  clip_method = method;
+}
+
+bool is_clip_guard_band(void)
+{
+  return clip_method == CLIP_GUARD_BAND;
+}
+
 void init_frustum_planes(float fov_x, float fov_y, float z_near, float z_far)
 {
   float sin_half_fov_x = sin(fov_x / 2);
@@ -42,6 +60,115 @@ void init_frustum_planes(float fov_x, float fov_y, float z_near, float z_far)
   frustum_planes[FAR_FRUSTUM_PLANE].normal.x = 0;
   frustum_planes[FAR_FRUSTUM_PLANE].normal.y = 0;
   frustum_planes[FAR_FRUSTUM_PLANE].normal.z = -1;
+
+  // guard band planes use a wider field of view, near and far stay the same
+  float guard_fov_x = atan(tan(fov_x / 2) * GUARD_BAND_FACTOR) * 2;
+  float guard_fov_y = atan(tan(fov_y / 2) * GUARD_BAND_FACTOR) * 2;
+  float sin_half_guard_x = sin(guard_fov_x / 2);
+  float cos_half_guard_x = cos(guard_fov_x / 2);
+  float sin_half_guard_y = sin(guard_fov_y / 2);
+  float cos_half_guard_y = cos(guard_fov_y / 2);
+
+  for (int i = 0; i < NUM_PLANES; i++)
+  {
+    guard_band_planes[i] = frustum_planes[i];
+  }
+
+  guard_band_planes[LEFT_FRUSTUM_PLANE].normal = vec3_new(cos_half_guard_x, 0, sin_half_guard_x);
+  guard_band_planes[RIGHT_FRUSTUM_PLANE].normal = vec3_new(-cos_half_guard_x, 0, sin_half_guard_x);
+  guard_band_planes[TOP_FRUSTUM_PLANE].normal = vec3_new(0, -cos_half_guard_y, sin_half_guard_y);
+  guard_band_planes[BOTTOM_FRUSTUM_PLANE].normal = vec3_new(0, cos_half_guard_y, sin_half_guard_y);
+}
+
+int compute_outcode(vec3_t vertex)
+{
+  int outcode = 0;
+  for (int plane = 0; plane < NUM_PLANES; plane++)
+  {
+    // same inside test as the clipper: points exactly on a plane count as outside
+    if (vec3_dot(vec3_sub(vertex, frustum_planes[plane].point), frustum_planes[plane].normal) <= 0)
+    {
+      outcode |= 1 << plane;
+    }
+  }
+  return outcode;
+}
+
+static bool is_inside_guard_band(vec3_t vertex, int side_outcodes)
+{
+  for (int plane = LEFT_FRUSTUM_PLANE; plane <= BOTTOM_FRUSTUM_PLANE; plane++)
+  {
+    if ((side_outcodes & (1 << plane)) && vec3_dot(vec3_sub(vertex, guard_band_planes[plane].point), guard_band_planes[plane].normal) <= 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+int classify_triangle(vec3_t v0, vec3_t v1, vec3_t v2)
+{
+  int outcode0 = compute_outcode(v0);
+  int outcode1 = compute_outcode(v1);
+  int outcode2 = compute_outcode(v2);
+
+  // all vertices outside of the same plane
+  if (outcode0 & outcode1 & outcode2)
+  {
+    count_geometry(faces_rejected, 1);
+    return TRIANGLE_OUTSIDE;
+  }
+
+  int outcodes = outcode0 | outcode1 | outcode2;
+
+  // with a guard band, crossing only side planes is fine as long as the vertices stay inside the band
+  if (is_clip_guard_band() && !(outcodes & ~OUTCODE_SIDES))
+  {
+    if (is_inside_guard_band(v0, outcode0) && is_inside_guard_band(v1, outcode1) && is_inside_guard_band(v2, outcode2))
+    {
+      outcodes = 0;
+    }
+  }
+
+  if (outcodes == 0)
+  {
+    count_geometry(faces_accepted, 1);
+    return TRIANGLE_INSIDE;
+  }
+
+  count_geometry(faces_clipped, 1);
+  return TRIANGLE_CLIPPED;
+}
+
+bool is_sphere_outside_frustum(vec3_t center, float radius)
+{
+  for (int plane = 0; plane < NUM_PLANES; plane++)
+  {
+    if (vec3_dot(vec3_sub(center, frustum_planes[plane].point), frustum_planes[plane].normal) < -radius)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// bring the camera space frustum planes into world space with the inverse of the
+// (rigid) view matrix, so world space bounds can be tested without transforming them
+void get_world_frustum_planes(mat4_t view_matrix, plane_t planes[NUM_PLANES])
+{
+  // the rows of the view matrix are the camera axes in world space
+  vec3_t x_axis = vec3_new(view_matrix.m[0][0], view_matrix.m[0][1], view_matrix.m[0][2]);
+  vec3_t y_axis = vec3_new(view_matrix.m[1][0], view_matrix.m[1][1], view_matrix.m[1][2]);
+  vec3_t z_axis = vec3_new(view_matrix.m[2][0], view_matrix.m[2][1], view_matrix.m[2][2]);
+  vec3_t translation = vec3_new(view_matrix.m[0][3], view_matrix.m[1][3], view_matrix.m[2][3]);
+
+  for (int plane = 0; plane < NUM_PLANES; plane++)
+  {
+    vec3_t point = vec3_sub(frustum_planes[plane].point, translation);
+    vec3_t normal = frustum_planes[plane].normal;
+    planes[plane].point = vec3_add(vec3_add(vec3_mul(x_axis, point.x), vec3_mul(y_axis, point.y)), vec3_mul(z_axis, point.z));
+    planes[plane].normal = vec3_add(vec3_add(vec3_mul(x_axis, normal.x), vec3_mul(y_axis, normal.y)), vec3_mul(z_axis, normal.z));
+  }
 }
 
 polygon_t polygon_from_triangle(vec3_t v0, vec3_t v1, vec3_t v2, tex2_t t0, tex2_t t1, tex2_t t2)
@@ -74,14 +201,50 @@ void triangles_from_polygon(polygon_t *polygon, triangle_t triangles[], int *num
   *num_triangles = polygon->num_vertices - 2;
 }
 
+static bool is_polygon_outside_plane(polygon_t *polygon, plane_t *plane)
+{
+  for (int i = 0; i < polygon->num_vertices; i++)
+  {
+    if (vec3_dot(vec3_sub(polygon->vertices[i], plane->point), plane->normal) > 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void clip_polygon_against(polygon_t *polygon, plane_t *plane);
+
 void clip_polygon(polygon_t *polygon)
 {
-  clip_polygon_against_plane(polygon, LEFT_FRUSTUM_PLANE);
-  clip_polygon_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
-  clip_polygon_against_plane(polygon, TOP_FRUSTUM_PLANE);
-  clip_polygon_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
-  clip_polygon_against_plane(polygon, NEAR_FRUSTUM_PLANE);
-  clip_polygon_against_plane(polygon, FAR_FRUSTUM_PLANE);
+  if (!is_clip_guard_band())
+  {
+    clip_polygon_against_plane(polygon, LEFT_FRUSTUM_PLANE);
+    clip_polygon_against_plane(polygon, RIGHT_FRUSTUM_PLANE);
+    clip_polygon_against_plane(polygon, TOP_FRUSTUM_PLANE);
+    clip_polygon_against_plane(polygon, BOTTOM_FRUSTUM_PLANE);
+    clip_polygon_against_plane(polygon, NEAR_FRUSTUM_PLANE);
+    clip_polygon_against_plane(polygon, FAR_FRUSTUM_PLANE);
+    return;
+  }
+
+  // polygons completely outside a side plane would not produce a single pixel
+  for (int plane = LEFT_FRUSTUM_PLANE; plane <= BOTTOM_FRUSTUM_PLANE; plane++)
+  {
+    if (is_polygon_outside_plane(polygon, &frustum_planes[plane]))
+    {
+      polygon->num_vertices = 0;
+      return;
+    }
+  }
+
+  // side planes only clip what sticks out of the guard band
+  clip_polygon_against(polygon, &guard_band_planes[LEFT_FRUSTUM_PLANE]);
+  clip_polygon_against(polygon, &guard_band_planes[RIGHT_FRUSTUM_PLANE]);
+  clip_polygon_against(polygon, &guard_band_planes[TOP_FRUSTUM_PLANE]);
+  clip_polygon_against(polygon, &guard_band_planes[BOTTOM_FRUSTUM_PLANE]);
+  clip_polygon_against(polygon, &frustum_planes[NEAR_FRUSTUM_PLANE]);
+  clip_polygon_against(polygon, &frustum_planes[FAR_FRUSTUM_PLANE]);
 }
 
 float float_lerp(float a, float b, float t)
@@ -91,25 +254,45 @@ float float_lerp(float a, float b, float t)
 
 void clip_polygon_against_plane(polygon_t *polygon, int plane)
 {
-  vec3_t plane_point = frustum_planes[plane].point;
-  vec3_t plane_normal = frustum_planes[plane].normal;
+  clip_polygon_against(polygon, &frustum_planes[plane]);
+}
 
-  vec3_t inside_vertices[MAX_NUM_POLY_VERTICES];
-  tex2_t inside_texcoords[MAX_NUM_POLY_VERTICES];
-  int num_inside_vertices = 0;
+static void clip_polygon_against(polygon_t *polygon, plane_t *plane)
+{
+  vec3_t plane_point = plane->point;
+  vec3_t plane_normal = plane->normal;
 
-  vec3_t *current_vertex = &polygon->vertices[0];
-  tex2_t *current_texcoord = &polygon->texcoords[0];
+  // distance of every vertex to the plane, computed once
+  float dots[MAX_NUM_POLY_VERTICES];
+  int num_vertices_inside_plane = 0;
+  for (int i = 0; i < polygon->num_vertices; i++)
+  {
+    dots[i] = vec3_dot(vec3_sub(polygon->vertices[i], plane_point), plane_normal);
+    if (dots[i] > 0)
+    {
+      num_vertices_inside_plane++;
+    }
+  }
 
-  vec3_t *previous_vertex = &polygon->vertices[polygon->num_vertices - 1];
-  tex2_t *previous_texcoord = &polygon->texcoords[polygon->num_vertices - 1];
+  // nothing to clip, keep the polygon as is without copying its vertices around
+  if (num_vertices_inside_plane == polygon->num_vertices)
+  {
+    return;
+  }
 
-  float current_dot = 0;
-  float previous_dot = vec3_dot(vec3_sub(*previous_vertex, plane_point), plane_normal);
+  vec3_t inside_vertices[MAX_NUM_POLY_VERTICES];
+  tex2_t inside_texcoords[MAX_NUM_POLY_VERTICES];
+  int num_inside_vertices = 0;
 
-  while (current_vertex != &polygon->vertices[polygon->num_vertices])
+  int previous = polygon->num_vertices - 1;
+  for (int current = 0; current < polygon->num_vertices; current++)
   {
-    current_dot = vec3_dot(vec3_sub(*current_vertex, plane_point), plane_normal);
+    vec3_t *current_vertex = &polygon->vertices[current];
+    tex2_t *current_texcoord = &polygon->texcoords[current];
+    vec3_t *previous_vertex = &polygon->vertices[previous];
+    tex2_t *previous_texcoord = &polygon->texcoords[previous];
+    float current_dot = dots[current];
+    float previous_dot = dots[previous];
 
     // if changing from inside to outside or vice versa, compute intersection
     if (current_dot * previous_dot < 0)
@@ -144,11 +327,7 @@ void clip_polygon_against_plane(polygon_t *polygon, int plane)
     }
 
     // move to the next vertex
-    previous_vertex = current_vertex;
-    previous_dot = current_dot;
-    previous_texcoord = current_texcoord;
-    current_vertex++;
-    current_texcoord++;
+    previous = current;
   }
 
   for (int i = 0; i < num_inside_vertices; i++)
@@ -0,0 +1,249 @@
+#include "cooked_mesh.h"
+#include "array.h"
+#include "asset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// every array is preceded by the capacity and occupied count of a dynamic array
+#define ARRAY_HEADER_SIZE (sizeof(int) * 2)
+
+bool get_cooked_mesh_path(const char *obj_path, char *path, size_t path_size)
+{
+  return replace_path_extension(obj_path, COOKED_MESH_EXTENSION, path, path_size);
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+  return (offset + COOKED_MESH_ALIGNMENT - 1) & ~(uint64_t)(COOKED_MESH_ALIGNMENT - 1);
+}
+
+// place an array after the ones placed so far, its items aligned and the
+// dynamic array header right in front of them
+static cooked_array_t place_array(uint64_t *file_size, void *array, size_t item_size)
+{
+  cooked_array_t placed = {
+    .count = array_length(array),
+    .item_size = item_size,
+  };
+  if (placed.count > 0)
+  {
+    placed.offset = align_offset(*file_size + ARRAY_HEADER_SIZE);
+    *file_size = placed.offset + (uint64_t)placed.count * item_size;
+  }
+  return placed;
+}
+
+static bool write_array(FILE *fp, uint64_t *position, cooked_array_t placed, const void *array)
+{
+  if (placed.count == 0)
+  {
+    return true;
+  }
+
+  static const unsigned char padding[COOKED_MESH_ALIGNMENT];
+  size_t padding_size = placed.offset - ARRAY_HEADER_SIZE - *position;
+  int header[2] = {placed.count, placed.count};
+  size_t data_size = (size_t)placed.count * placed.item_size;
+  if (fwrite(padding, 1, padding_size, fp) != padding_size || fwrite(header, 1, sizeof(header), fp) != sizeof(header) ||
+      fwrite(array, 1, data_size, fp) != data_size)
+  {
+    return false;
+  }
+  *position = placed.offset + data_size;
+  return true;
+}
+
+bool write_cooked_mesh(const char *path, mesh_t *mesh, uint64_t source_hash)
+{
+  cooked_mesh_header_t header = {
+    .magic = COOKED_MESH_MAGIC,
+    .version = COOKED_MESH_VERSION,
+    .num_lods = mesh->num_lods,
+    .source_hash = source_hash,
+    .bounds_center = mesh->bounds_center,
+    .bounds_radius = mesh->bounds_radius,
+    .cache_miss_ratio_before = mesh->cache_miss_ratio_before,
+    .cache_miss_ratio_after = mesh->cache_miss_ratio_after,
+  };
+
+  uint64_t file_size = sizeof(header);
+  header.vertices = place_array(&file_size, mesh->vertices, sizeof(vec3_t));
+  header.welded_vertices = place_array(&file_size, mesh->welded_vertices, sizeof(mesh_vertex_t));
+  for (int i = 0; i < mesh->num_lods; i++)
+  {
+    header.faces[i] = place_array(&file_size, mesh->lods[i].faces, sizeof(face_t));
+    header.face_planes[i] = place_array(&file_size, mesh->lods[i].face_planes, sizeof(face_plane_t));
+    header.meshlets[i] = place_array(&file_size, mesh->lods[i].meshlets, sizeof(meshlet_t));
+    header.indices[i] = place_array(&file_size, mesh->lods[i].indices, sizeof(uint32_t));
+  }
+
+  // written next to the final path and renamed over it, so a running
+  // renderer never maps a half written file
+  char temp_path[1024];
+  if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path))
+  {
+    fprintf(stderr, "Error: cooked mesh path %s is too long.\n", path);
+    return false;
+  }
+
+  FILE *fp = fopen(temp_path, "wb");
+  if (fp == NULL)
+  {
+    perror("Error creating cooked mesh file");
+    return false;
+  }
+
+  uint64_t position = sizeof(header);
+  bool is_written = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+                    write_array(fp, &position, header.vertices, mesh->vertices) &&
+                    write_array(fp, &position, header.welded_vertices, mesh->welded_vertices);
+  for (int i = 0; is_written && i < mesh->num_lods; i++)
+  {
+    is_written = write_array(fp, &position, header.faces[i], mesh->lods[i].faces) &&
+                 write_array(fp, &position, header.face_planes[i], mesh->lods[i].face_planes) &&
+                 write_array(fp, &position, header.meshlets[i], mesh->lods[i].meshlets) &&
+                 write_array(fp, &position, header.indices[i], mesh->lods[i].indices);
+  }
+  is_written = fclose(fp) == 0 && is_written;
+
+  if (!is_written || rename(temp_path, path) != 0)
+  {
+    fprintf(stderr, "Error: could not write %s.\n", path);
+    remove(temp_path);
+    return false;
+  }
+  return true;
+}
+
+// the items of a placed array inside the mapping, NULL when it is empty or
+// does not lie inside the file as a dynamic array of the expected items
+static void *map_array(const unsigned char *data, size_t size, cooked_array_t placed, size_t item_size, bool *is_valid)
+{
+  if (placed.count == 0)
+  {
+    return NULL;
+  }
+
+  if (placed.item_size != item_size || placed.offset % COOKED_MESH_ALIGNMENT != 0 ||
+      placed.offset < sizeof(cooked_mesh_header_t) + ARRAY_HEADER_SIZE || placed.offset > size ||
+      (uint64_t)placed.count * item_size > size - placed.offset)
+  {
+    *is_valid = false;
+    return NULL;
+  }
+
+  void *array = (void *)(data + placed.offset);
+  if (array_length(array) != (int)placed.count)
+  {
+    *is_valid = false;
+    return NULL;
+  }
+  return array;
+}
+
+// every index of a level inside the arrays it indexes, checked once so a
+// damaged file that still maps cannot send the pipeline out of bounds
+static bool is_lod_in_range(mesh_t *mesh, mesh_lod_t *lod)
+{
+  int num_faces = array_length(lod->faces);
+  if (array_length(lod->face_planes) != num_faces || array_length(lod->indices) != num_faces * 3)
+  {
+    return false;
+  }
+
+  int num_vertices = array_length(mesh->vertices);
+  for (int i = 0; i < num_faces; i++)
+  {
+    face_t *face = &lod->faces[i];
+    if (face->a < 0 || face->a >= num_vertices || face->b < 0 || face->b >= num_vertices || face->c < 0 || face->c >= num_vertices)
+    {
+      return false;
+    }
+  }
+
+  uint32_t num_welded_vertices = array_length(mesh->welded_vertices);
+  for (int i = 0; i < num_faces * 3; i++)
+  {
+    if (lod->indices[i] >= num_welded_vertices)
+    {
+      return false;
+    }
+  }
+
+  for (int i = 0; i < array_length(lod->meshlets); i++)
+  {
+    meshlet_t *meshlet = &lod->meshlets[i];
+    if (meshlet->first_face < 0 || meshlet->num_faces < 0 || meshlet->num_faces > num_faces - meshlet->first_face)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool load_cooked_mesh(mesh_t *mesh, const char *path, uint64_t source_hash)
+{
+  // a missing file is the normal case before cooking, not an error
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  fclose(fp);
+
+  size_t size;
+  const unsigned char *data = map_file(path, &size);
+  if (data == NULL)
+  {
+    return false;
+  }
+
+  cooked_mesh_header_t header;
+  if (size < sizeof(header))
+  {
+    unmap_file(data, size);
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != COOKED_MESH_MAGIC || header.version != COOKED_MESH_VERSION || header.source_hash != source_hash ||
+      header.num_lods < 1 || header.num_lods > MAX_NUM_MESH_LODS)
+  {
+    unmap_file(data, size);
+    return false;
+  }
+
+  mesh_t cooked = {
+    .num_lods = header.num_lods,
+    .bounds_center = header.bounds_center,
+    .bounds_radius = header.bounds_radius,
+    .cache_miss_ratio_before = header.cache_miss_ratio_before,
+    .cache_miss_ratio_after = header.cache_miss_ratio_after,
+    .cooked_data = data,
+    .cooked_size = size,
+  };
+  bool is_valid = true;
+  cooked.vertices = map_array(data, size, header.vertices, sizeof(vec3_t), &is_valid);
+  cooked.welded_vertices = map_array(data, size, header.welded_vertices, sizeof(mesh_vertex_t), &is_valid);
+  for (int i = 0; i < cooked.num_lods; i++)
+  {
+    cooked.lods[i].faces = map_array(data, size, header.faces[i], sizeof(face_t), &is_valid);
+    cooked.lods[i].face_planes = map_array(data, size, header.face_planes[i], sizeof(face_plane_t), &is_valid);
+    cooked.lods[i].meshlets = map_array(data, size, header.meshlets[i], sizeof(meshlet_t), &is_valid);
+    cooked.lods[i].indices = map_array(data, size, header.indices[i], sizeof(uint32_t), &is_valid);
+  }
+  for (int i = 0; is_valid && i < cooked.num_lods; i++)
+  {
+    is_valid = is_lod_in_range(&cooked, &cooked.lods[i]);
+  }
+
+  if (!is_valid)
+  {
+    fprintf(stderr, "Error: %s is damaged, parsing the OBJ file instead.\n", path);
+    unmap_file(data, size);
+    return false;
+  }
+
+  *mesh = cooked;
+  return true;
+}
@@ -0,0 +1,107 @@
+#include "cooked_texture.h"
+#include "asset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool get_cooked_texture_path(const char *png_path, char *path, size_t path_size)
+{
+  return replace_path_extension(png_path, COOKED_TEXTURE_EXTENSION, path, path_size);
+}
+
+bool write_cooked_texture(const char *path, const texture_level_t *level, uint64_t source_hash)
+{
+  cooked_texture_header_t header = {
+    .magic = COOKED_TEXTURE_MAGIC,
+    .version = COOKED_TEXTURE_VERSION,
+    .texel_size = sizeof(uint32_t),
+    .source_hash = source_hash,
+    .width = level->width,
+    .height = level->height,
+    .texels_offset = (sizeof(header) + COOKED_TEXTURE_ALIGNMENT - 1) & ~(size_t)(COOKED_TEXTURE_ALIGNMENT - 1),
+  };
+
+  // written next to the final path and renamed over it, so another run never
+  // maps a half written file
+  char temp_path[1024];
+  if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path))
+  {
+    fprintf(stderr, "Error: cooked texture path %s is too long.\n", path);
+    return false;
+  }
+
+  FILE *fp = fopen(temp_path, "wb");
+  if (fp == NULL)
+  {
+    perror("Error creating cooked texture file");
+    return false;
+  }
+
+  static const unsigned char padding[COOKED_TEXTURE_ALIGNMENT];
+  size_t padding_size = header.texels_offset - sizeof(header);
+  size_t texels_size = (size_t)level->width * level->height * sizeof(uint32_t);
+  bool is_written = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+                    fwrite(padding, 1, padding_size, fp) == padding_size &&
+                    fwrite(level->texels, 1, texels_size, fp) == texels_size;
+  is_written = fclose(fp) == 0 && is_written;
+
+  if (!is_written || rename(temp_path, path) != 0)
+  {
+    fprintf(stderr, "Error: could not write %s.\n", path);
+    remove(temp_path);
+    return false;
+  }
+  return true;
+}
+
+bool load_cooked_texture(texture_level_t *level, const char *path, uint64_t source_hash)
+{
+  // a missing file is the normal case before the first decode, not an error
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  fclose(fp);
+
+  size_t size;
+  const unsigned char *data = map_file(path, &size);
+  if (data == NULL)
+  {
+    return false;
+  }
+
+  cooked_texture_header_t header;
+  if (size < sizeof(header))
+  {
+    unmap_file(data, size);
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != COOKED_TEXTURE_MAGIC || header.version != COOKED_TEXTURE_VERSION ||
+      header.texel_size != sizeof(uint32_t) || header.source_hash != source_hash)
+  {
+    unmap_file(data, size);
+    return false;
+  }
+
+  uint64_t texels_size = (uint64_t)header.width * header.height * sizeof(uint32_t);
+  if (header.width == 0 || header.height == 0 || header.width > INT32_MAX || header.height > INT32_MAX ||
+      header.texels_offset % COOKED_TEXTURE_ALIGNMENT != 0 || header.texels_offset < sizeof(header) ||
+      header.texels_offset > size || texels_size > size - header.texels_offset)
+  {
+    fprintf(stderr, "Error: %s is damaged, decoding the PNG file instead.\n", path);
+    unmap_file(data, size);
+    return false;
+  }
+
+  *level = (texture_level_t){
+    .width = header.width,
+    .height = header.height,
+    .texels = (uint32_t *)(data + header.texels_offset),
+    .cooked_data = data,
+    .cooked_size = size,
+    .is_cooked = true,
+  };
+  return true;
+}
@@ -1,25 +1,60 @@
 #include <display.h>
+#include "display_backend.h"
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-static SDL_Window *window = NULL;
-static SDL_Renderer *renderer = NULL;
+static const display_backend_t *backend = &sdl_display_backend;
 
-static uint32_t *color_buffer = NULL;
+static uint32_t *color_buffers[NUM_COLOR_BUFFERS] = {NULL};
+static uint32_t *color_buffer = NULL; // the one being drawn into
 static float *z_buffer = NULL;
 
-static SDL_Texture *color_buffer_texture = NULL;
 static int window_width = 800;
 static int window_height = 600;
 
-static int fullscreen_window_width;
-static int fullscreen_window_height;
+// 0 by 0 for the backend default
+static int requested_width = 0;
+static int requested_height = 0;
+
+// presented frames written to PPM files, see set_frame_dump()
+static char frame_dump_prefix[1024] = "";
+static int frame_dump_interval = 0;
+static int num_frames_presented = 0;
+static SDL_AtomicInt is_frame_dump_requested;
+
+static const char *backend_names[] = {"sdl", "headless"};
+static const char *render_method_names[] = {"wire", "wire-vertex", "filled", "filled-wire", "textured", "textured-wire"};
 
 int render_method = 0;
 int cull_method = 0;
 
+bool parse_display_backend(const char *name, int *backend_index)
+{
+  for (int i = 0; i < (int)(sizeof(backend_names) / sizeof(backend_names[0])); i++)
+  {
+    if (strcmp(name, backend_names[i]) == 0)
+    {
+      *backend_index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void set_display_backend(int backend_index)
+{
+  backend = backend_index == DISPLAY_BACKEND_HEADLESS ? &headless_display_backend : &sdl_display_backend;
+}
+
+void set_display_resolution(int width, int height)
+{
+  requested_width = width;
+  requested_height = height;
+}
+
 int get_window_width(void)
 {
   return window_width;
@@ -32,77 +67,55 @@ int get_window_height(void)
 
 bool initialize_window(void)
 {
-  if (!SDL_Init(SDL_INIT_VIDEO))
+  int width = requested_width;
+  int height = requested_height;
+  if (!backend->open(&width, &height))
   {
-    fprintf(stderr, "Error: SDL_Init(): %s.\n", SDL_GetError());
     return false;
   }
+  window_width = width;
+  window_height = height;
 
-  // query screen resolution
-  int num_displays = 0;
-  SDL_DisplayID *displays = SDL_GetDisplays(&num_displays);
-  if (num_displays <= 0 || !displays)
+  // allocate memory for color buffers and z-buffer
+  for (int i = 0; i < NUM_COLOR_BUFFERS; i++)
   {
-    fprintf(stderr, "Error: No displays found: %s\n", SDL_GetError());
-    fullscreen_window_width = 800; // fallback resolution
-    fullscreen_window_height = 600;
+    color_buffers[i] = (uint32_t *)malloc(sizeof(uint32_t) * window_width * window_height);
   }
-  else
+  color_buffer = color_buffers[0];
+  z_buffer = (float *)malloc(sizeof(float) * window_width * window_height);
+
+  for (int i = 0; i < NUM_COLOR_BUFFERS; i++)
   {
-    const SDL_DisplayMode *display_mode = SDL_GetCurrentDisplayMode(displays[0]);
-    if (!display_mode)
+    if (color_buffers[i] == NULL)
     {
-      fprintf(stderr, "Error: SDL_GetCurrentDisplayMode(): %s\n", SDL_GetError());
-      fullscreen_window_width = 800; // fallback resolution
-      fullscreen_window_height = 600;
+      fprintf(stderr, "Error: out of memory for a %dx%d color buffer.\n", window_width, window_height);
+      return false;
     }
-    else
-    {
-      fullscreen_window_width = display_mode->w;
-      fullscreen_window_height = display_mode->h;
-    }
-    SDL_free(displays);
   }
-
-  // simulate low resolution display
-  window_width = fullscreen_window_width / 3;
-  window_height = fullscreen_window_height / 3;
-
-  // create SDL window
-  window = SDL_CreateWindow(NULL, window_width, window_height, SDL_WINDOW_BORDERLESS);
-  if (!window)
+  if (z_buffer == NULL)
   {
-    fprintf(stderr, "Error: SDL_CreateWindow(): %s.\n", SDL_GetError());
+    fprintf(stderr, "Error: out of memory for a %dx%d z-buffer.\n", window_width, window_height);
     return false;
   }
+  return true;
+}
 
-  // create SDL renderer
-  renderer = SDL_CreateRenderer(window, NULL);
-  SDL_SetRenderVSync(renderer, 1);
-  if (!renderer)
+bool parse_render_method(const char *name, int *method)
+{
+  for (int i = 0; i < (int)(sizeof(render_method_names) / sizeof(render_method_names[0])); i++)
   {
-    fprintf(stderr, "Error: SDL_CreateRenderer(): %s.\n", SDL_GetError());
-    return false;
+    if (strcmp(name, render_method_names[i]) == 0)
+    {
+      *method = i;
+      return true;
+    }
   }
+  return false;
+}
 
-  SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
-  SDL_SetWindowFullscreen(window, true);
-  SDL_ShowWindow(window);
-
-  // allocate memory for color buffer and z-buffer
-  color_buffer = (uint32_t *)malloc(sizeof(uint32_t) * window_width * window_height);
-  z_buffer = (float *)malloc(sizeof(float) * window_width * window_height);
-
-  //  create SDL texture for color buffer
-  color_buffer_texture = SDL_CreateTexture(
-    renderer,
-    SDL_PIXELFORMAT_RGBA32,
-    SDL_TEXTUREACCESS_STREAMING,
-    window_width,
-    window_height
-  );
-
-  return true;
+const char *get_render_method_name(int method)
+{
+  return render_method_names[method];
 }
 
 void set_render_method(int method)
@@ -110,6 +123,11 @@ void set_render_method(int method)
   render_method = method;
 }
 
+int get_render_method(void)
+{
+  return render_method;
+}
+
 void set_cull_method(int method)
 {
   cull_method = method;
@@ -120,24 +138,24 @@ bool is_cull_backface(void)
   return cull_method == CULL_BACKFACE;
 }
 
-bool should_render_filled_triangles(void)
+bool should_render_filled_triangles(int method)
 {
-  return render_method == RENDER_FILL_TRIANGLE || render_method == RENDER_FILL_TRIANGLE_WIRE;
+  return method == RENDER_FILL_TRIANGLE || method == RENDER_FILL_TRIANGLE_WIRE;
 }
 
-bool should_render_textured_triangle(void)
+bool should_render_textured_triangle(int method)
 {
-  return render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIRE;
+  return method == RENDER_TEXTURED || method == RENDER_TEXTURED_WIRE;
 }
 
-bool should_render_wireframe(void)
+bool should_render_wireframe(int method)
 {
-  return render_method != RENDER_FILL_TRIANGLE && render_method != RENDER_TEXTURED;
+  return method != RENDER_FILL_TRIANGLE && method != RENDER_TEXTURED;
 }
 
-bool should_render_wire_vertex(void)
+bool should_render_wire_vertex(int method)
 {
-  return render_method == RENDER_WIRE_VERTEX;
+  return method == RENDER_WIRE_VERTEX;
 }
 
 void draw_pixel(int x, int y, uint32_t color)
@@ -198,11 +216,70 @@ void draw_rect(int x, int y, int width, int height, uint32_t color)
   }
 }
 
-void render_color_buffer(void)
+void set_color_buffer_target(int index)
+{
+  color_buffer = color_buffers[index];
+}
+
+void set_frame_dump(const char *prefix, int interval)
+{
+  snprintf(frame_dump_prefix, sizeof(frame_dump_prefix), "%s", prefix);
+  frame_dump_interval = interval;
+}
+
+void request_frame_dump(void)
 {
-  SDL_UpdateTexture(color_buffer_texture, NULL, color_buffer, (window_width * sizeof(uint32_t)));
-  SDL_RenderTexture(renderer, color_buffer_texture, NULL, NULL);
-  SDL_RenderPresent(renderer);
+  SDL_SetAtomicInt(&is_frame_dump_requested, 1);
+}
+
+// binary PPM, the RGB bytes of every pixel with the alpha dropped
+static void dump_color_buffer(const uint32_t *pixels, int frame)
+{
+  char path[1100];
+  snprintf(path, sizeof(path), "%s%05d.ppm", frame_dump_prefix[0] != '\0' ? frame_dump_prefix : "frame", frame);
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+  {
+    perror("Error creating frame dump file");
+    return;
+  }
+
+  unsigned char *row = (unsigned char *)malloc((size_t)window_width * 3);
+  bool is_written = row != NULL && fprintf(fp, "P6\n%d %d\n255\n", window_width, window_height) > 0;
+  for (int y = 0; y < window_height && is_written; y++)
+  {
+    const unsigned char *bytes = (const unsigned char *)&pixels[y * window_width];
+    for (int x = 0; x < window_width; x++)
+    {
+      row[x * 3 + 0] = bytes[x * 4 + 0];
+      row[x * 3 + 1] = bytes[x * 4 + 1];
+      row[x * 3 + 2] = bytes[x * 4 + 2];
+    }
+    is_written = fwrite(row, 1, (size_t)window_width * 3, fp) == (size_t)window_width * 3;
+  }
+  free(row);
+
+  if (fclose(fp) != 0 || !is_written)
+  {
+    fprintf(stderr, "Error: could not write %s.\n", path);
+  }
+}
+
+void render_color_buffer(int index)
+{
+  int frame = num_frames_presented++;
+  bool is_dumped = (frame_dump_interval > 0 && frame % frame_dump_interval == 0) ||
+                   SDL_CompareAndSwapAtomicInt(&is_frame_dump_requested, 1, 0);
+  if (is_dumped)
+  {
+    dump_color_buffer(color_buffers[index], frame);
+  }
+  backend->upload(color_buffers[index], window_width, window_height);
+}
+
+void present_color_buffer(void)
+{
+  backend->present();
 }
 
 void clear_color_buffer(uint32_t color)
@@ -243,10 +320,11 @@ void set_zbuffer_at(int x, int y, float value)
 
 void destroy_window(void)
 {
-  free(color_buffer);
+  for (int i = 0; i < NUM_COLOR_BUFFERS; i++)
+  {
+    free(color_buffers[i]);
+  }
   free(z_buffer);
 
-  SDL_DestroyRenderer(renderer);
-  SDL_DestroyWindow(window);
-  SDL_Quit();
+  backend->close();
 }
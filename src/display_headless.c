@@ -0,0 +1,48 @@
+#include "display_backend.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+// resolution when none is asked for, the size of the SDL window on a 2400x1800 display
+#define HEADLESS_DISPLAY_WIDTH 800
+#define HEADLESS_DISPLAY_HEIGHT 600
+
+static bool open_headless_display(int *width, int *height)
+{
+  // only the event queue, which needs no display; it still turns SIGINT
+  // into a quit event
+  if (!SDL_Init(SDL_INIT_EVENTS))
+  {
+    fprintf(stderr, "Error: SDL_Init(): %s.\n", SDL_GetError());
+    return false;
+  }
+
+  if (*width <= 0 || *height <= 0)
+  {
+    *width = HEADLESS_DISPLAY_WIDTH;
+    *height = HEADLESS_DISPLAY_HEIGHT;
+  }
+  return true;
+}
+
+static void upload_headless_display(const uint32_t *pixels, int width, int height)
+{
+  (void)pixels;
+  (void)width;
+  (void)height;
+}
+
+static void present_headless_display(void)
+{
+}
+
+static void close_headless_display(void)
+{
+  SDL_Quit();
+}
+
+const display_backend_t headless_display_backend = {
+  .open = open_headless_display,
+  .upload = upload_headless_display,
+  .present = present_headless_display,
+  .close = close_headless_display,
+};
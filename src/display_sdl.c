@@ -0,0 +1,107 @@
+#include "display_backend.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+static SDL_Window *window = NULL;
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *color_buffer_texture = NULL;
+
+static bool open_sdl_display(int *width, int *height)
+{
+  if (!SDL_Init(SDL_INIT_VIDEO))
+  {
+    fprintf(stderr, "Error: SDL_Init(): %s.\n", SDL_GetError());
+    return false;
+  }
+
+  // query screen resolution
+  int fullscreen_window_width = 800; // fallback resolution
+  int fullscreen_window_height = 600;
+  int num_displays = 0;
+  SDL_DisplayID *displays = SDL_GetDisplays(&num_displays);
+  if (num_displays <= 0 || !displays)
+  {
+    fprintf(stderr, "Error: No displays found: %s\n", SDL_GetError());
+  }
+  else
+  {
+    const SDL_DisplayMode *display_mode = SDL_GetCurrentDisplayMode(displays[0]);
+    if (!display_mode)
+    {
+      fprintf(stderr, "Error: SDL_GetCurrentDisplayMode(): %s\n", SDL_GetError());
+    }
+    else
+    {
+      fullscreen_window_width = display_mode->w;
+      fullscreen_window_height = display_mode->h;
+    }
+    SDL_free(displays);
+  }
+
+  // simulate low resolution display
+  if (*width <= 0 || *height <= 0)
+  {
+    *width = fullscreen_window_width / 3;
+    *height = fullscreen_window_height / 3;
+  }
+
+  // create SDL window
+  window = SDL_CreateWindow(NULL, *width, *height, SDL_WINDOW_BORDERLESS);
+  if (!window)
+  {
+    fprintf(stderr, "Error: SDL_CreateWindow(): %s.\n", SDL_GetError());
+    return false;
+  }
+
+  // create SDL renderer
+  renderer = SDL_CreateRenderer(window, NULL);
+  SDL_SetRenderVSync(renderer, 1);
+  if (!renderer)
+  {
+    fprintf(stderr, "Error: SDL_CreateRenderer(): %s.\n", SDL_GetError());
+    return false;
+  }
+
+  SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+  SDL_SetWindowFullscreen(window, true);
+  SDL_ShowWindow(window);
+
+  //  create SDL texture for color buffer
+  color_buffer_texture = SDL_CreateTexture(
+    renderer,
+    SDL_PIXELFORMAT_RGBA32,
+    SDL_TEXTUREACCESS_STREAMING,
+    *width,
+    *height
+  );
+
+  return true;
+}
+
+static void upload_sdl_display(const uint32_t *pixels, int width, int height)
+{
+  (void)height;
+  SDL_UpdateTexture(color_buffer_texture, NULL, pixels, (width * sizeof(uint32_t)));
+  SDL_RenderTexture(renderer, color_buffer_texture, NULL, NULL);
+}
+
+// waits for vsync
+static void present_sdl_display(void)
+{
+  SDL_RenderPresent(renderer);
+}
+
+static void close_sdl_display(void)
+{
+  SDL_DestroyTexture(color_buffer_texture);
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+}
+
+const display_backend_t sdl_display_backend = {
+  .open = open_sdl_display,
+  .upload = upload_sdl_display,
+  .present = present_sdl_display,
+  .close = close_sdl_display,
+};
@@ -0,0 +1,193 @@
+#include "frame_scheduler.h"
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <string.h>
+
+// the adaptive mode lowers the rate when the average work takes more than
+// this much of the frame, and raises it again when it would take less than
+// the low fraction of the faster frame
+#define ADAPTIVE_HIGH_LOAD 0.9
+#define ADAPTIVE_LOW_LOAD 0.7
+#define ADAPTIVE_WORK_SMOOTHING 0.1
+
+// frame times are counted in a histogram of this resolution, so a session of
+// any length takes the same memory; longer frames share the last bin
+#define FRAME_TIME_BIN_NS 50000
+#define NUM_FRAME_TIME_BINS 5000
+
+static const char *mode_names[] = {"uncapped", "fixed", "adaptive"};
+
+static int schedule_mode = FRAME_SCHEDULE_ADAPTIVE;
+static uint64_t target_period_ns = 0;
+static int rate_divisor = 1;
+
+static uint64_t frame_start_ns = 0; // 0 before the first frame
+static uint64_t frame_deadline_ns = 0;
+static uint64_t step_accumulator_ns = 0;
+static double average_work_ns = 0;
+
+static int frame_time_bins[NUM_FRAME_TIME_BINS];
+static int num_frame_times = 0;
+static double frame_time_ns_sum = 0;
+static double frame_time_ns_max = 0;
+static double work_ns_sum = 0;
+static int num_ended_frames = 0;
+
+bool parse_frame_schedule_mode(const char *name, int *mode)
+{
+  for (int i = 0; i < (int)(sizeof(mode_names) / sizeof(mode_names[0])); i++)
+  {
+    if (strcmp(name, mode_names[i]) == 0)
+    {
+      *mode = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *get_frame_schedule_mode_name(int mode)
+{
+  return mode_names[mode];
+}
+
+void init_frame_scheduler(int mode, int target_fps)
+{
+  schedule_mode = mode;
+  target_period_ns = SDL_NS_PER_SECOND / target_fps;
+  rate_divisor = 1;
+  frame_start_ns = 0;
+  frame_deadline_ns = 0;
+  step_accumulator_ns = 0;
+  average_work_ns = 0;
+  memset(frame_time_bins, 0, sizeof(frame_time_bins));
+  num_frame_times = 0;
+  frame_time_ns_sum = 0;
+  frame_time_ns_max = 0;
+  work_ns_sum = 0;
+  num_ended_frames = 0;
+}
+
+// sleep until the frame slot, then move the deadline one slot on; a frame
+// that missed its slot starts the next one from now instead of catching up
+static uint64_t wait_for_frame_slot(void)
+{
+  uint64_t now = SDL_GetTicksNS();
+  if (now < frame_deadline_ns)
+  {
+    SDL_DelayPrecise(frame_deadline_ns - now);
+    now = SDL_GetTicksNS();
+  }
+
+  uint64_t period = target_period_ns * rate_divisor;
+  if (now - frame_deadline_ns < period)
+  {
+    frame_deadline_ns += period;
+  }
+  else
+  {
+    frame_deadline_ns = now + period;
+  }
+  return now;
+}
+
+frame_schedule_t begin_frame(void)
+{
+  uint64_t now = schedule_mode == FRAME_SCHEDULE_ADAPTIVE ? wait_for_frame_slot() : SDL_GetTicksNS();
+
+  // the first frame simulates one target period
+  uint64_t delta_ns = target_period_ns;
+  if (frame_start_ns != 0)
+  {
+    delta_ns = now - frame_start_ns;
+    uint64_t bin = delta_ns / FRAME_TIME_BIN_NS;
+    frame_time_bins[bin < NUM_FRAME_TIME_BINS ? bin : NUM_FRAME_TIME_BINS - 1]++;
+    num_frame_times++;
+    frame_time_ns_sum += delta_ns;
+    frame_time_ns_max = fmax(frame_time_ns_max, delta_ns);
+  }
+  frame_start_ns = now;
+
+  frame_schedule_t schedule = {
+    .num_steps = 1,
+    .step_time = (double)delta_ns / SDL_NS_PER_SECOND,
+    .interpolation = 1.0,
+  };
+
+  if (schedule_mode == FRAME_SCHEDULE_FIXED_STEP)
+  {
+    uint64_t max_step_ns = MAX_FRAME_STEP_TIME * SDL_NS_PER_SECOND;
+    step_accumulator_ns += delta_ns < max_step_ns ? delta_ns : max_step_ns;
+    schedule.num_steps = step_accumulator_ns / target_period_ns;
+    step_accumulator_ns -= schedule.num_steps * target_period_ns;
+    schedule.step_time = (double)target_period_ns / SDL_NS_PER_SECOND;
+    schedule.interpolation = (double)step_accumulator_ns / target_period_ns;
+  }
+
+  return schedule;
+}
+
+void end_frame(double stage_ns)
+{
+  double work_ns = SDL_GetTicksNS() - frame_start_ns;
+  work_ns_sum += work_ns;
+  num_ended_frames++;
+
+  if (schedule_mode != FRAME_SCHEDULE_ADAPTIVE)
+  {
+    return;
+  }
+
+  // halve, third, ... the rate while the work does not fit into a frame,
+  // and go back up once it fits into the faster frame with room to spare
+  double frame_cost_ns = work_ns > stage_ns ? work_ns : stage_ns;
+  average_work_ns += (frame_cost_ns - average_work_ns) * ADAPTIVE_WORK_SMOOTHING;
+  if (average_work_ns > ADAPTIVE_HIGH_LOAD * target_period_ns * rate_divisor && rate_divisor < MAX_FRAME_RATE_DIVISOR)
+  {
+    rate_divisor++;
+  }
+  else if (rate_divisor > 1 && average_work_ns < ADAPTIVE_LOW_LOAD * target_period_ns * (rate_divisor - 1))
+  {
+    rate_divisor--;
+  }
+}
+
+// middle of the bin holding the frame time of this rank in sorted order,
+// never more than the longest frame
+static double get_frame_time_ns_at_rank(int rank)
+{
+  int count = 0;
+  for (int bin = 0; bin < NUM_FRAME_TIME_BINS; bin++)
+  {
+    count += frame_time_bins[bin];
+    if (count > rank)
+    {
+      return fmin((bin + 0.5) * FRAME_TIME_BIN_NS, frame_time_ns_max);
+    }
+  }
+  return frame_time_ns_max;
+}
+
+frame_time_stats_t get_frame_time_stats(void)
+{
+  frame_time_stats_t stats = {.rate_divisor = rate_divisor};
+
+  stats.num_frames = num_frame_times;
+  if (num_frame_times == 0)
+  {
+    return stats;
+  }
+
+  stats.mean_ms = frame_time_ns_sum / num_frame_times / 1e6;
+  stats.p50_ms = get_frame_time_ns_at_rank(num_frame_times / 2) / 1e6;
+  stats.p99_ms = get_frame_time_ns_at_rank((int)((num_frame_times - 1) * 0.99)) / 1e6;
+  stats.max_ms = frame_time_ns_max / 1e6;
+  stats.mean_work_ms = work_ns_sum / num_ended_frames / 1e6;
+  return stats;
+}
+
+void free_frame_scheduler(void)
+{
+  memset(frame_time_bins, 0, sizeof(frame_time_bins));
+  num_frame_times = 0;
+}
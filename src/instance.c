@@ -0,0 +1,273 @@
+#include "instance.h"
+#include "array.h"
+#include "bvh.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "texture.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// slot map: handles index the slots, the slots index the dense arrays; removing
+// an instance moves the last dense instance into the hole, so iteration never
+// sees gaps and no compaction pass is needed
+typedef struct
+{
+  int dense_index; // position in the dense arrays, or the next free slot
+  uint32_t generation;
+  bool is_used;
+} instance_slot_t;
+
+static instance_slot_t *slots = NULL; // dynamic array of slots
+static int first_free_slot = -1;
+
+static instance_t *instances = NULL; // dynamic array, the first instance_count entries are live
+static int *instance_slots = NULL;   // slot of every dense instance
+static int instance_count = 0;
+
+// world bounds of every slot, rebuilt when new slots appear or refitting has
+// made the tree this much more costly to query than right after its build,
+// otherwise only refit
+#define INSTANCE_BVH_MAX_COST_GROWTH 1.5f
+static bvh_t instance_bvh;
+static bool is_instance_bvh_stale = true;
+static int num_bounds_changes = 0; // since the last refit
+static float built_bvh_cost = 0;
+
+// bounding sphere of the mesh moved into world space, as a box
+static aabb_t get_instance_world_bounds(instance_t *instance)
+{
+  mat4_t world_matrix = mat4_make_world(instance->scale, instance->rotation, instance->translation);
+  vec3_t center = vec3_from_vec4(mat4_mul_vec4(world_matrix, vec4_from_vec3(instance->mesh->bounds_center)));
+  float max_scale = fmaxf(fabsf(instance->scale.x), fmaxf(fabsf(instance->scale.y), fabsf(instance->scale.z)));
+  return aabb_from_sphere(center, instance->mesh->bounds_radius * max_scale);
+}
+
+static void set_slot_bounds(int slot, aabb_t bounds)
+{
+  if (is_instance_bvh_stale || slot >= array_length(instance_bvh.item_bounds))
+  {
+    is_instance_bvh_stale = true;
+    return;
+  }
+
+  bvh_set_item_bounds(&instance_bvh, slot, bounds);
+  num_bounds_changes++;
+}
+
+static void update_instance_bvh(void)
+{
+  if (!is_instance_bvh_stale && num_bounds_changes > 0)
+  {
+    bvh_refit(&instance_bvh);
+    num_bounds_changes = 0;
+    is_instance_bvh_stale = bvh_get_cost(&instance_bvh) > built_bvh_cost * INSTANCE_BVH_MAX_COST_GROWTH;
+  }
+
+  if (is_instance_bvh_stale)
+  {
+    int num_slots = array_length(slots);
+    aabb_t *bounds = (aabb_t *)malloc(sizeof(aabb_t) * (num_slots > 0 ? num_slots : 1));
+    for (int i = 0; i < num_slots; i++)
+    {
+      bounds[i] = slots[i].is_used ? get_instance_world_bounds(&instances[slots[i].dense_index]) : aabb_empty();
+    }
+    bvh_build(&instance_bvh, bounds, num_slots);
+    free(bounds);
+    is_instance_bvh_stale = false;
+    built_bvh_cost = bvh_get_cost(&instance_bvh);
+  }
+}
+
+instance_handle_t add_instance(mesh_t *mesh, texture_t *texture, vec3_t scale, vec3_t translation, vec3_t rotation)
+{
+  if (mesh == NULL)
+  {
+    release_texture(texture);
+    return (instance_handle_t){0};
+  }
+
+  // reuse a free slot before growing the slot array
+  int slot = first_free_slot;
+  if (slot >= 0)
+  {
+    first_free_slot = slots[slot].dense_index;
+  }
+  else
+  {
+    instance_slot_t new_slot = {0};
+    array_push(slots, new_slot);
+    slot = array_length(slots) - 1;
+  }
+
+  instance_t instance = {
+    .mesh = mesh,
+    .texture = texture,
+    .rotation = rotation,
+    .scale = scale,
+    .translation = translation,
+  };
+  if (instance_count < array_length(instances))
+  {
+    instances[instance_count] = instance;
+    instance_slots[instance_count] = slot;
+  }
+  else
+  {
+    array_push(instances, instance);
+    array_push(instance_slots, slot);
+  }
+
+  slots[slot].dense_index = instance_count++;
+  slots[slot].is_used = true;
+  if (++slots[slot].generation == 0)
+  {
+    slots[slot].generation = 1;
+  }
+
+  set_slot_bounds(slot, get_instance_world_bounds(&instances[slots[slot].dense_index]));
+
+  return (instance_handle_t){slot, slots[slot].generation};
+}
+
+static bool is_handle_valid(instance_handle_t handle)
+{
+  return handle.slot >= 0 && handle.slot < array_length(slots) &&
+         slots[handle.slot].is_used && slots[handle.slot].generation == handle.generation;
+}
+
+void remove_instance(instance_handle_t handle)
+{
+  if (!is_handle_valid(handle))
+  {
+    return;
+  }
+
+  int slot = handle.slot;
+  int dense_index = slots[slot].dense_index;
+  release_mesh(instances[dense_index].mesh);
+  release_texture(instances[dense_index].texture);
+
+  // fill the hole with the last instance
+  int last = --instance_count;
+  instances[dense_index] = instances[last];
+  instance_slots[dense_index] = instance_slots[last];
+  slots[instance_slots[dense_index]].dense_index = dense_index;
+
+  slots[slot].is_used = false;
+  slots[slot].dense_index = first_free_slot;
+  first_free_slot = slot;
+
+  set_slot_bounds(slot, aabb_empty());
+}
+
+instance_t *get_instance(instance_handle_t handle)
+{
+  return is_handle_valid(handle) ? &instances[slots[handle.slot].dense_index] : NULL;
+}
+
+bool set_instance_transform(instance_handle_t handle, vec3_t scale, vec3_t rotation, vec3_t translation)
+{
+  instance_t *instance = get_instance(handle);
+  if (instance == NULL)
+  {
+    return false;
+  }
+
+  instance->scale = scale;
+  instance->rotation = rotation;
+  instance->translation = translation;
+  set_slot_bounds(handle.slot, get_instance_world_bounds(instance));
+
+  return true;
+}
+
+int get_num_instances(void)
+{
+  return instance_count;
+}
+
+instance_t *get_instances(void)
+{
+  return instances;
+}
+
+// turn the slot indices returned by the bvh into handles
+static void slots_to_handles(int *items, instance_handle_t **handles)
+{
+  for (int i = 0; i < array_length(items); i++)
+  {
+    instance_handle_t handle = {items[i], slots[items[i]].generation};
+    array_push(*handles, handle);
+  }
+}
+
+static int compare_handles_by_mesh(const void *a, const void *b)
+{
+  const instance_handle_t *handle_a = (const instance_handle_t *)a;
+  const instance_handle_t *handle_b = (const instance_handle_t *)b;
+  mesh_t *mesh_a = instances[slots[handle_a->slot].dense_index].mesh;
+  mesh_t *mesh_b = instances[slots[handle_b->slot].dense_index].mesh;
+  if (mesh_a != mesh_b)
+    return (mesh_a > mesh_b) - (mesh_a < mesh_b);
+  return (handle_a->slot > handle_b->slot) - (handle_a->slot < handle_b->slot);
+}
+
+// scratch array for the slot indices of a query
+static int *query_slots = NULL;
+
+void query_visible_instances(mat4_t view_matrix, instance_handle_t **visible)
+{
+  update_instance_bvh();
+  array_clear(*visible);
+  array_clear(query_slots);
+
+  plane_t planes[NUM_PLANES];
+  get_world_frustum_planes(view_matrix, planes);
+  bvh_query_frustum(&instance_bvh, planes, &query_slots);
+  slots_to_handles(query_slots, visible);
+
+  // draw the instances of one mesh back to back, so its vertices stay in cache
+  if (array_length(*visible) > 1)
+  {
+    qsort(*visible, array_length(*visible), sizeof(instance_handle_t), compare_handles_by_mesh);
+  }
+}
+
+void query_instances_in_box(aabb_t box, instance_handle_t **results)
+{
+  update_instance_bvh();
+  array_clear(query_slots);
+  bvh_query_box(&instance_bvh, box, &query_slots);
+  slots_to_handles(query_slots, results);
+}
+
+void query_instances_along_ray(vec3_t origin, vec3_t direction, float max_distance, instance_handle_t **results)
+{
+  update_instance_bvh();
+  array_clear(query_slots);
+  bvh_query_ray(&instance_bvh, origin, direction, max_distance, &query_slots);
+  slots_to_handles(query_slots, results);
+}
+
+void free_instances(void)
+{
+  for (int i = 0; i < instance_count; i++)
+  {
+    release_mesh(instances[i].mesh);
+    release_texture(instances[i].texture);
+  }
+  array_free(instances);
+  array_free(instance_slots);
+  array_free(slots);
+  array_free(query_slots);
+  instances = NULL;
+  instance_slots = NULL;
+  slots = NULL;
+  query_slots = NULL;
+  instance_count = 0;
+  first_free_slot = -1;
+
+  bvh_free(&instance_bvh);
+  is_instance_bvh_stale = true;
+}
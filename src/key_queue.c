@@ -0,0 +1,33 @@
+#include "key_queue.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+static SDL_Keycode keys[KEY_QUEUE_SIZE];
+static SDL_AtomicInt first_key; // advanced by the consumer
+static SDL_AtomicInt end_key;   // advanced by the producer
+
+void push_key(SDL_Keycode key)
+{
+  int end = SDL_GetAtomicInt(&end_key);
+  if (end - SDL_GetAtomicInt(&first_key) == KEY_QUEUE_SIZE)
+  {
+    fprintf(stderr, "Error: key queue full, key press dropped.\n");
+    return;
+  }
+
+  keys[end % KEY_QUEUE_SIZE] = key;
+  SDL_SetAtomicInt(&end_key, end + 1);
+}
+
+bool pop_key(SDL_Keycode *key)
+{
+  int first = SDL_GetAtomicInt(&first_key);
+  if (first == SDL_GetAtomicInt(&end_key))
+  {
+    return false;
+  }
+
+  *key = keys[first % KEY_QUEUE_SIZE];
+  SDL_SetAtomicInt(&first_key, first + 1);
+  return true;
+}
@@ -1,34 +1,218 @@
 #include "array.h"
+#include "asset.h"
+#include "asset_loader.h"
+#include "benchmark.h"
 #include "camera.h"
 #include "clipping.h"
 #include "display.h"
+#include "frame_scheduler.h"
+#include "instance.h"
+#include "key_queue.h"
 #include "light.h"
 #include "matrix.h"
 #include "mesh.h"
+#include "obj_parser.h"
+#include "occlusion.h"
+#include "pipeline_stats.h"
+#include "raster_thread.h"
+#include "render_queue.h"
+#include "texture_compression.h"
 #include "triangle.h"
 #include "vector.h"
+#include "vertex_cache.h"
 #include <SDL3/SDL_keycode.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-// Global variable for runtime status and game loop
-bool is_running = false;
-uint32_t previous_frame_time = 0;
+// Global variable for runtime status and game loop, shared by the main and the geometry thread
+SDL_AtomicInt is_running;
 float delta_time = 0;
 
-// Array to store triangles that should be rendered each frame
-#define MAX_TRIANGLES 10000
-triangle_t triangles_to_render[MAX_TRIANGLES];
-int num_triangles_to_render = 0;
+// Frame pacing (--schedule uncapped|fixed|adaptive, --fps N)
+int schedule_mode = FRAME_SCHEDULE_ADAPTIVE;
+int target_fps = FPS;
+
+// Queue of triangles the geometry stage fills this frame, while the raster thread draws the other one
+#define INITIAL_RENDER_QUEUE_CAPACITY 10000
+render_queue_t *render_queue = NULL;
+
+// Sleep of the main thread between checks for a new frame when none is ready
+#define PRESENT_POLL_NS 250000
+
+// Handles of the instances inside the view frustum this frame
+instance_handle_t *visible_instances = NULL;
+
+// Number of instances placed in a grid instead of the default scene (--instances N)
+#define GRID_SPACING 4.0
+int num_grid_instances = 0;
+
+// Instance waiting for its mesh and texture, added to the scene once both are loaded
+typedef struct
+{
+  mesh_t *mesh;
+  texture_t *texture;
+  int num_loading;
+  vec3_t scale;
+  vec3_t translation;
+  vec3_t rotation;
+  bool is_occluder;
+} pending_instance_t;
+pending_instance_t **pending_instances = NULL;
+
+// Start of the program and the first presented frame, for the time to the first frame
+uint64_t program_start_ns = 0;
+uint64_t first_present_ns = 0;
+
+// Frames to present before quitting, 0 to run until closed (--frames N)
+int max_frames_presented = 0;
+int num_frames_presented = 0;
+
+// Render method of the first frame (--render-method name)
+int initial_render_method = RENDER_TEXTURED;
+
+// Scripted run over one asset, the runway scene or the instance grid instead of
+// interactive input (--benchmark scene), drawing a fixed number of frames along
+// a camera path; the grid has BENCHMARK_GRID_INSTANCES unless --instances is given
+#define BENCHMARK_GRID_INSTANCES 1000
+const char *benchmark_scenes[] = {"cube", "f22", "efa", "f117", "crab", "drone", "runway", "grid"};
+const char *benchmark_scene = NULL;
+int benchmark_path = BENCHMARK_PATH_ORBIT;
+int num_benchmark_frames = 300;
+const char *benchmark_json_path = NULL;
+
+// Time spent clipping in the current frame, which the geometry stage time includes
+double frame_clip_ns = 0;
+
+// Faces seen and faces rejected a whole meshlet at a time
+typedef struct
+{
+  int num_faces;
+  int num_faces_skipped;
+  double skipped_fraction_sum; // sum of the per-frame skipped fractions
+  int num_frames;
+} meshlet_stats_t;
+meshlet_stats_t meshlet_stats;
+
+// Instances that passed frustum culling, against all instances in the scene
+typedef struct
+{
+  double num_visible_sum;
+  double num_instances_sum;
+} instance_visibility_stats_t;
+instance_visibility_stats_t instance_visibility_stats;
+
+// Instances hidden behind occluders and the time spent and saved by the occlusion pass
+typedef struct
+{
+  double num_culled_sum;
+  double num_tested_sum;
+  double pass_ns_sum;   // clearing, rasterizing occluders and testing
+  double saved_ns_sum;  // culled faces times the measured pipeline cost per face
+  int num_frames;
+  double pipeline_ns;   // pipeline time and faces of the drawn instances in this frame
+  double pipeline_faces;
+} occlusion_stats_t;
+occlusion_stats_t occlusion_stats;
+
+// Geometry stage time and the time the main thread spends uploading and presenting frames
+typedef struct
+{
+  double geometry_ns_sum;
+  double present_ns_sum;
+} frame_stage_times_t;
+frame_stage_times_t frame_stage_times;
+
+// FIFO cache of the last camera space vertices of an instance, keyed by welded vertex index
+typedef struct
+{
+  uint32_t indices[VERTEX_CACHE_SIZE];
+  vec4_t vertices[VERTEX_CACHE_SIZE];
+  int next;
+} transformed_vertex_cache_t;
+
+// Vertices of drawn faces taken from the transformed vertex cache, against all of them
+typedef struct
+{
+  double num_hits;
+  double num_lookups;
+} vertex_cache_stats_t;
+vertex_cache_stats_t vertex_cache_stats;
+
+// Faces submitted per frame after level of detail selection, against the full meshes
+typedef struct
+{
+  double num_lod_faces_sum;
+  double num_full_faces_sum;
+  int num_lod_switches;
+} lod_stats_t;
+lod_stats_t lod_stats;
 
 // Declaration of global transformation vertices
 mat4_t world_matrix;
 mat4_t proj_matrix;
 mat4_t view_matrix;
+camera_t view_camera; // camera the current frame is built from
+
+void add_pending_instance_when_ready(pending_instance_t *pending)
+{
+  if (--pending->num_loading > 0)
+  {
+    return;
+  }
+
+  // the instance takes over both references, a missing mesh releases the texture
+  instance_handle_t handle = add_instance(pending->mesh, pending->texture, pending->scale, pending->translation, pending->rotation);
+  pending->mesh = NULL;
+  pending->texture = NULL;
+  if (get_instance(handle) != NULL)
+  {
+    get_instance(handle)->is_occluder = pending->is_occluder;
+  }
+}
+
+void on_instance_mesh_ready(void *data, void *user_data)
+{
+  pending_instance_t *pending = (pending_instance_t *)user_data;
+  pending->mesh = (mesh_t *)data;
+  add_pending_instance_when_ready(pending);
+}
+
+void on_instance_texture_ready(void *data, void *user_data)
+{
+  pending_instance_t *pending = (pending_instance_t *)user_data;
+  pending->texture = (texture_t *)data;
+  add_pending_instance_when_ready(pending);
+}
+
+// place an instance once its files are loaded in the background, so frames
+// are drawn from the start and meshes appear as they finish
+void add_instance_async(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation, bool is_occluder)
+{
+  pending_instance_t *pending = (pending_instance_t *)calloc(1, sizeof(pending_instance_t));
+  if (pending == NULL)
+  {
+    return;
+  }
+  pending->num_loading = 2;
+  pending->scale = scale;
+  pending->translation = translation;
+  pending->rotation = rotation;
+  pending->is_occluder = is_occluder;
+  array_push(pending_instances, pending);
+
+  load_mesh_async(obj_filename, on_instance_mesh_ready, pending);
+  load_texture_async(png_filename, on_instance_texture_ready, pending);
+}
 
 void setup(void)
 {
-  set_render_method(RENDER_TEXTURED);
+  init_camera(vec3_new(0, 0, 0), vec3_new(0, 0, 1));
+  init_frame_scheduler(schedule_mode, target_fps);
+
+  set_render_method(initial_render_method);
   set_cull_method(CULL_BACKFACE);
 
   // initialize light
@@ -41,17 +225,51 @@ void setup(void)
   float fov_x = atan(tan(fov_y / 2.0) * aspect_x) * 2.0;
   float z_near = 0.1;
   float z_far = 100.0;
+
+  // the instance grid reaches further than the default scene; the benchmark
+  // paths view it from up to three radii from its center, so its far side is
+  // four radii away
+  int grid_columns = ceil(sqrt(num_grid_instances));
+  float grid_radius = GRID_SPACING * grid_columns * M_SQRT1_2;
+  z_far = fmax(z_far, 4 * grid_radius);
   proj_matrix = mat4_make_perspective(fov_y, aspect_y, z_near, z_far);
 
   // initialize frustum planes
   init_frustum_planes(fov_x, fov_y, z_near, z_far);
 
-  load_mesh("../assets/runway.obj", "../assets/runway.png", vec3_new(1, 1, 1), vec3_new(0, -1.5, 23), vec3_new(0, 0, 0));
-  load_mesh("../assets/f22.obj", "../assets/f22.png", vec3_new(1, 1, 1), vec3_new(-1.5, -1.3, 5), vec3_new(0, -M_PI / 2, 0));
-  load_mesh("../assets/efa.obj", "../assets/efa.png", vec3_new(1, 1, 1), vec3_new(1.5, -1.3, 5), vec3_new(0, -M_PI / 2, 0));
-  load_mesh("../assets/f117.obj", "../assets/f117.png", vec3_new(1, 1, 1), vec3_new(0, -1.3, 9), vec3_new(0, -M_PI / 2, 0));
+  init_occlusion_buffer(get_window_width(), get_window_height(), proj_matrix);
+
+  // a single asset in front of the camera, or the instance grid or the runway scene below
+  if (benchmark_scene != NULL && strcmp(benchmark_scene, "runway") != 0 && strcmp(benchmark_scene, "grid") != 0)
+  {
+    char obj_filename[256];
+    char png_filename[256];
+    snprintf(obj_filename, sizeof(obj_filename), "../assets/%s.obj", benchmark_scene);
+    snprintf(png_filename, sizeof(png_filename), "../assets/%s.png", benchmark_scene);
+    add_instance_async(obj_filename, png_filename, vec3_new(1, 1, 1), vec3_new(0, 0, 5), vec3_new(0, -M_PI / 2, 0), false);
+    return;
+  }
+
+  if (num_grid_instances > 0)
+  {
+    // one F-22 placed many times in a square grid in front of the camera;
+    // the files are loaded once and every instance waits for that load
+    for (int i = 0; i < num_grid_instances; i++)
+    {
+      vec3_t translation = vec3_new((i % grid_columns - grid_columns / 2) * GRID_SPACING, -1.3, 5 + (i / grid_columns) * GRID_SPACING);
+      add_instance_async("../assets/f22.obj", "../assets/f22.png", vec3_new(1, 1, 1), translation, vec3_new(0, -M_PI / 2, 0), false);
+    }
+    return;
+  }
+
+  add_instance_async("../assets/runway.obj", "../assets/runway.png", vec3_new(1, 1, 1), vec3_new(0, -1.5, 23), vec3_new(0, 0, 0), true);
+  add_instance_async("../assets/f22.obj", "../assets/f22.png", vec3_new(1, 1, 1), vec3_new(-1.5, -1.3, 5), vec3_new(0, -M_PI / 2, 0), false);
+  add_instance_async("../assets/efa.obj", "../assets/efa.png", vec3_new(1, 1, 1), vec3_new(1.5, -1.3, 5), vec3_new(0, -M_PI / 2, 0), false);
+  add_instance_async("../assets/f117.obj", "../assets/f117.png", vec3_new(1, 1, 1), vec3_new(0, -1.3, 9), vec3_new(0, -M_PI / 2, 0), false);
 }
 
+// runs on the main thread, which has to poll the events; everything a key
+// changes belongs to the geometry thread, so key presses are passed on
 void process_input(void)
 {
   SDL_Event event;
@@ -60,64 +278,87 @@ void process_input(void)
     switch (event.type)
     {
     case SDL_EVENT_QUIT:
-      is_running = false;
+      SDL_SetAtomicInt(&is_running, 0);
       break;
     case SDL_EVENT_KEY_DOWN:
-      switch (event.key.key)
+      if (event.key.key == SDLK_ESCAPE)
       {
-      case SDLK_ESCAPE:
-        is_running = false;
-        break;
-      case SDLK_C:
-        set_cull_method(CULL_BACKFACE);
-        break;
-      case SDLK_X:
-        set_cull_method(CULL_NONE);
-        break;
-      case SDLK_1:
-        set_render_method(RENDER_WIRE_VERTEX);
-        break;
-      case SDLK_2:
-        set_render_method(RENDER_WIRE);
-        break;
-      case SDLK_3:
-        set_render_method(RENDER_FILL_TRIANGLE);
-        break;
-      case SDLK_4:
-        set_render_method(RENDER_FILL_TRIANGLE_WIRE);
-        break;
-      case SDLK_5:
-        set_render_method(RENDER_TEXTURED);
-        break;
-      case SDLK_6:
-        set_render_method(RENDER_TEXTURED_WIRE);
-        break;
-      case SDLK_UP:
-        update_camera_forward_velocity(vec3_mul(get_camera_direction(), 5.0 * delta_time));
-        update_camera_position(vec3_add(get_camera_position(), get_camera_forward_velocity()));
-        break;
-      case SDLK_DOWN:
-        update_camera_forward_velocity(vec3_mul(get_camera_direction(), 5.0 * delta_time));
-        update_camera_position(vec3_sub(get_camera_position(), get_camera_forward_velocity()));
-        break;
-      case SDLK_LEFT:
-        rotate_camera_yaw(-1.0 * delta_time);
-        break;
-      case SDLK_RIGHT:
-        rotate_camera_yaw(1.0 * delta_time);
-        break;
-      case SDLK_W:
-        rotate_camera_pitch(3.0 * delta_time);
-        break;
-      case SDLK_S:
-        rotate_camera_pitch(-3.0 * delta_time);
-        break;
+        SDL_SetAtomicInt(&is_running, 0);
       }
-      break; // break swich key down event
+      else
+      {
+        push_key(event.key.key);
+      }
+      break;
     }
   }
 };
 
+// runs on the geometry thread in the first simulation step of a frame
+void apply_key_presses(void)
+{
+  SDL_Keycode key;
+  while (pop_key(&key))
+  {
+    switch (key)
+    {
+    case SDLK_C:
+      set_cull_method(CULL_BACKFACE);
+      break;
+    case SDLK_X:
+      set_cull_method(CULL_NONE);
+      break;
+    case SDLK_G:
+      set_clip_method(CLIP_GUARD_BAND);
+      break;
+    case SDLK_F:
+      set_clip_method(CLIP_FRUSTUM);
+      break;
+    case SDLK_1:
+      set_render_method(RENDER_WIRE_VERTEX);
+      break;
+    case SDLK_2:
+      set_render_method(RENDER_WIRE);
+      break;
+    case SDLK_3:
+      set_render_method(RENDER_FILL_TRIANGLE);
+      break;
+    case SDLK_4:
+      set_render_method(RENDER_FILL_TRIANGLE_WIRE);
+      break;
+    case SDLK_5:
+      set_render_method(RENDER_TEXTURED);
+      break;
+    case SDLK_6:
+      set_render_method(RENDER_TEXTURED_WIRE);
+      break;
+    case SDLK_UP:
+      update_camera_forward_velocity(vec3_mul(get_camera_direction(), 5.0 * delta_time));
+      update_camera_position(vec3_add(get_camera_position(), get_camera_forward_velocity()));
+      break;
+    case SDLK_DOWN:
+      update_camera_forward_velocity(vec3_mul(get_camera_direction(), 5.0 * delta_time));
+      update_camera_position(vec3_sub(get_camera_position(), get_camera_forward_velocity()));
+      break;
+    case SDLK_LEFT:
+      rotate_camera_yaw(-1.0 * delta_time);
+      break;
+    case SDLK_RIGHT:
+      rotate_camera_yaw(1.0 * delta_time);
+      break;
+    case SDLK_W:
+      rotate_camera_pitch(3.0 * delta_time);
+      break;
+    case SDLK_S:
+      rotate_camera_pitch(-3.0 * delta_time);
+      break;
+    case SDLK_P:
+      request_frame_dump();
+      break;
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Process the graphics pipeline stages for each mesh
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -149,247 +390,844 @@ void process_input(void)
 //                         | Screen Space |   <-- ready to render
 //                         +--------------+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void process_graphics_pipeline_stages(mesh_t *mesh)
+// camera space position of a welded vertex, transformed only when it is not among the last ones
+vec4_t transform_cached_vertex(transformed_vertex_cache_t *cache, mesh_t *mesh, uint32_t index)
 {
+  vertex_cache_stats.num_lookups++;
+  for (int i = 0; i < VERTEX_CACHE_SIZE; i++)
+  {
+    if (cache->indices[i] == index)
+    {
+      vertex_cache_stats.num_hits++;
+      return cache->vertices[i];
+    }
+  }
+
+  vec4_t transformed_vertex = vec4_from_vec3(mesh->welded_vertices[index].position);
+
+  transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
+
+  // Multiply the view matrix by the vector to transform the scene to camera space
+  transformed_vertex = mat4_mul_vec4(view_matrix, transformed_vertex);
+
+  cache->indices[cache->next] = index;
+  cache->vertices[cache->next] = transformed_vertex;
+  cache->next = (cache->next + 1) % VERTEX_CACHE_SIZE;
+  return transformed_vertex;
+}
+
+void process_graphics_pipeline_stages(instance_t *instance)
+{
+  mesh_t *mesh = instance->mesh;
+
   ////////////////////////////
   // transformation matrix
   ///////////////////////////
-  // create matrix for perfoming rotation / scale / translation
-  mat4_t scale_matrix = mat4_make_scale(mesh->scale.x, mesh->scale.y, mesh->scale.z);
-  mat4_t translation_matrix = mat4_make_translation(mesh->translation.x, mesh->translation.y, mesh->translation.z);
-  mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh->rotation.x);
-  mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh->rotation.y);
-  mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh->rotation.z);
-
-  //////////////////////
-  // view matrix (camera)
-  //////////////////////
-  vec3_t camera_target = get_camera_lookat_target();
-  vec3_t camera_up_direction = vec3_new(0, 1, 0);
-  view_matrix = mat4_look_at(get_camera_position(), camera_target, camera_up_direction);
+  // world matrix (scale * rotation * translation matrices)
+  world_matrix = mat4_make_world(instance->scale, instance->rotation, instance->translation);
 
-  int num_faces = array_length(mesh->faces);
-  for (int i = 0; i < num_faces; i++)
-  {
-    face_t mesh_face = mesh->faces[i];
+  // bring the camera into model space once, so back faces can be rejected
+  // against the precomputed face planes before any vertex is transformed
+  mat4_t inverse_world_matrix = mat4_make_inverse_world(instance->scale, instance->rotation, instance->translation);
+  vec3_t camera_model_position = vec3_from_vec4(mat4_mul_vec4(inverse_world_matrix, vec4_from_vec3(view_camera.position)));
 
-    vec3_t face_vertices[3];
-    face_vertices[0] = mesh->vertices[mesh_face.a];
-    face_vertices[1] = mesh->vertices[mesh_face.b];
-    face_vertices[2] = mesh->vertices[mesh_face.c];
+  // model to camera space for points
+  mat4_t world_view_matrix = mat4_mul_mat4(view_matrix, world_matrix);
 
-    // perform transformations
-    vec4_t transformed_vertices[3];
-    for (int j = 0; j < 3; j++)
-    {
-      vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
+  // model to camera space for face normals, used by lighting: the inverse
+  // transpose keeps them perpendicular to the faces under non-uniform scale,
+  // and leaving out the translation keeps their w at 0 for the view matrix
+  mat4_t inverse_model_matrix = mat4_make_inverse_world(instance->scale, instance->rotation, vec3_new(0, 0, 0));
+  mat4_t normal_matrix = mat4_mul_mat4(view_matrix, mat4_transpose(inverse_model_matrix));
 
-      // world matrix (scale * rotation * translation matrices)
-      // order matters: scale - rotation - translation
-      world_matrix = mat4_identity();
-      world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
-      world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-      world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-      world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-      world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
+  // meshlet bounding spheres are in model space, scale their radius to camera space
+  float max_scale = fmaxf(fabsf(instance->scale.x), fmaxf(fabsf(instance->scale.y), fabsf(instance->scale.z)));
 
-      transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
+  // pick the level of detail from the projected radius of the mesh bounding sphere in pixels
+  vec3_t bounds_center = vec3_from_vec4(mat4_mul_vec4(world_view_matrix, vec4_from_vec3(mesh->bounds_center)));
+  float bounds_radius = mesh->bounds_radius * max_scale;
+  float screen_radius = INFINITY;
+  if (bounds_center.z > bounds_radius)
+  {
+    screen_radius = bounds_radius / bounds_center.z * proj_matrix.m[1][1] * (get_window_height() / 2.0);
+  }
+  int previous_lod = instance->current_lod;
+  instance->current_lod = select_mesh_lod(mesh, instance->current_lod, screen_radius);
+  if (instance->current_lod != previous_lod)
+  {
+    lod_stats.num_lod_switches++;
+  }
+  mesh_lod_t *lod = &mesh->lods[instance->current_lod];
+  lod_stats.num_lod_faces_sum += array_length(lod->faces);
+  lod_stats.num_full_faces_sum += array_length(mesh->lods[0].faces);
 
-      // Multiply the view matrix by the vector to transform the scene to camera space
-      transformed_vertex = mat4_mul_vec4(view_matrix, transformed_vertex);
+  // faces are ordered so consecutive ones share vertices
+  transformed_vertex_cache_t vertex_cache;
+  memset(vertex_cache.indices, 0xff, sizeof(vertex_cache.indices));
+  vertex_cache.next = 0;
 
-      transformed_vertices[j] = transformed_vertex;
-    }
+  // the texels may have been evicted, then the placeholder is drawn until they are back
+  const texture_level_t *texture = use_texture(instance->texture);
 
-    // calculate triangle face normal
-    vec3_t face_normal = get_triangle_normal(transformed_vertices);
+  int num_meshlets = array_length(lod->meshlets);
+  for (int m = 0; m < num_meshlets; m++)
+  {
+    meshlet_t *meshlet = &lod->meshlets[m];
+    meshlet_stats.num_faces += meshlet->num_faces;
+    count_geometry(faces_in, meshlet->num_faces);
+
+    // reject the whole meshlet when all of its faces point away from the camera
+    if (is_cull_backface() && is_meshlet_backfacing(meshlet, camera_model_position))
+    {
+      meshlet_stats.num_faces_skipped += meshlet->num_faces;
+      count_geometry(faces_backface_culled, meshlet->num_faces);
+      continue;
+    }
 
-    // perform back-face culling
-    if (is_cull_backface())
+    // reject the whole meshlet when its bounding sphere is outside the frustum
+    vec3_t meshlet_center = vec3_from_vec4(mat4_mul_vec4(world_view_matrix, vec4_from_vec3(meshlet->center)));
+    if (is_sphere_outside_frustum(meshlet_center, meshlet->radius * max_scale))
     {
-      // find the vector between vertex A in the triangle and the camera origin
-      vec3_t camera_ray = vec3_sub(vec3_new(0, 0, 0), vec3_from_vec4(transformed_vertices[0]));
+      meshlet_stats.num_faces_skipped += meshlet->num_faces;
+      count_geometry(faces_rejected, meshlet->num_faces);
+      continue;
+    }
 
-      // calculate how align the camera ray is with the face normal
-      float dot_normal_camera = vec3_dot(face_normal, camera_ray);
+    for (int i = meshlet->first_face; i < meshlet->first_face + meshlet->num_faces; i++)
+    {
+      face_t mesh_face = lod->faces[i];
+      face_plane_t face_plane = lod->face_planes[i];
 
-      if (dot_normal_camera < 0)
+      // perform back-face culling: skip faces whose plane has the camera behind it
+      if (is_cull_backface() && vec3_dot(face_plane.normal, camera_model_position) < face_plane.distance)
       {
+        count_geometry(faces_backface_culled, 1);
         continue;
       }
-    }
 
-    // create polygon from triangle vertices to perform clipping
-    polygon_t polygon = polygon_from_triangle(
-      vec3_from_vec4(transformed_vertices[0]),
-      vec3_from_vec4(transformed_vertices[1]),
-      vec3_from_vec4(transformed_vertices[2]),
-      mesh_face.a_uv,
-      mesh_face.b_uv,
-      mesh_face.c_uv
-    );
+      // perform transformations
+      uint32_t *face_indices = &lod->indices[i * 3];
+      vec4_t transformed_vertices[3];
+      for (int j = 0; j < 3; j++)
+      {
+        transformed_vertices[j] = transform_cached_vertex(&vertex_cache, mesh, face_indices[j]);
+      }
 
-    // clip the polygon against the frustum planes
-    clip_polygon(&polygon);
+      // bring the precomputed face normal into camera space (w = 0 ignores translation)
+      vec4_t model_normal = {face_plane.normal.x, face_plane.normal.y, face_plane.normal.z, 0};
+      vec3_t face_normal = vec3_from_vec4(mat4_mul_vec4(normal_matrix, model_normal));
+      vec3_normalize(&face_normal);
 
-    // break the polygon into triangles after clipping
-    triangle_t triangles_after_clipping[MAX_NUM_POLY_TRIANGLES];
-    int num_triangles_after_clipping = 0;
-    triangles_from_polygon(&polygon, triangles_after_clipping, &num_triangles_after_clipping);
+      // trivially accept or reject the triangle before doing any clipping work
+      int visibility = classify_triangle(
+        vec3_from_vec4(transformed_vertices[0]),
+        vec3_from_vec4(transformed_vertices[1]),
+        vec3_from_vec4(transformed_vertices[2])
+      );
+      if (visibility == TRIANGLE_OUTSIDE)
+      {
+        continue;
+      }
 
-    // loop through each triangle after clipping
-    for (int t = 0; t < num_triangles_after_clipping; t++)
-    {
-      triangle_t triangle_after_clipping = triangles_after_clipping[t];
+      triangle_t triangles_after_clipping[MAX_NUM_POLY_TRIANGLES];
+      int num_triangles_after_clipping = 0;
 
-      // perform projection
-      vec4_t projected_points[3];
-      for (int j = 0; j < 3; j++)
+      if (visibility == TRIANGLE_INSIDE)
       {
-        projected_points[j] = mat4_mul_vec4_project(proj_matrix, triangle_after_clipping.points[j]);
+        // nothing to clip, the triangle goes straight to projection
+        triangles_after_clipping[0] = (triangle_t){
+          .points = {transformed_vertices[0], transformed_vertices[1], transformed_vertices[2]},
+          .texcoords = {mesh_face.a_uv, mesh_face.b_uv, mesh_face.c_uv},
+        };
+        num_triangles_after_clipping = 1;
+      }
+      else
+      {
+        uint64_t clip_start = SDL_GetTicksNS();
+
+        // create polygon from triangle vertices to perform clipping
+        polygon_t polygon = polygon_from_triangle(
+          vec3_from_vec4(transformed_vertices[0]),
+          vec3_from_vec4(transformed_vertices[1]),
+          vec3_from_vec4(transformed_vertices[2]),
+          mesh_face.a_uv,
+          mesh_face.b_uv,
+          mesh_face.c_uv
+        );
 
-        // scale into the view
-        projected_points[j].x *= (get_window_width() / 2.0);
-        projected_points[j].y *= -(get_window_height() / 2.0);
+        // clip the polygon against the frustum planes (or only the guard band for the side planes)
+        clip_polygon(&polygon);
 
-        // translate the projected points into the middle of the screen
-        projected_points[j].x += (get_window_width() / 2.0);
-        projected_points[j].y += (get_window_height() / 2.0);
+        // break the polygon into triangles after clipping
+        triangles_from_polygon(&polygon, triangles_after_clipping, &num_triangles_after_clipping);
+        frame_clip_ns += SDL_GetTicksNS() - clip_start;
       }
 
-      // perform lighting calculation
-      float light_intensity = -vec3_dot(face_normal, get_light_direction());
-      uint32_t triangle_color = light_apply_intensity(mesh_face.color, light_intensity);
-
-      triangle_t triangle_to_render = {
-        .points = {
-          {projected_points[0].x, projected_points[0].y, projected_points[0].z, projected_points[0].w},
-          {projected_points[1].x, projected_points[1].y, projected_points[1].z, projected_points[1].w},
-          {projected_points[2].x, projected_points[2].y, projected_points[2].z, projected_points[2].w},
-        },
-        .texcoords = {
-          triangle_after_clipping.texcoords[0],
-          triangle_after_clipping.texcoords[1],
-          triangle_after_clipping.texcoords[2],
-        },
-        .color = triangle_color,
-        .texture = mesh->texture,
-      };
-
-      if (num_triangles_to_render < MAX_TRIANGLES)
+      // loop through each triangle after clipping
+      for (int t = 0; t < num_triangles_after_clipping; t++)
       {
-        triangles_to_render[num_triangles_to_render++] = triangle_to_render;
+        triangle_t triangle_after_clipping = triangles_after_clipping[t];
+
+        // perform projection
+        vec4_t projected_points[3];
+        for (int j = 0; j < 3; j++)
+        {
+          projected_points[j] = mat4_mul_vec4_project(proj_matrix, triangle_after_clipping.points[j]);
+
+          // scale into the view
+          projected_points[j].x *= (get_window_width() / 2.0);
+          projected_points[j].y *= -(get_window_height() / 2.0);
+
+          // translate the projected points into the middle of the screen
+          projected_points[j].x += (get_window_width() / 2.0);
+          projected_points[j].y += (get_window_height() / 2.0);
+        }
+
+        // perform lighting calculation
+        float light_intensity = -vec3_dot(face_normal, get_light_direction());
+        uint32_t triangle_color = light_apply_intensity(mesh_face.color, light_intensity);
+
+        render_command_t *command = render_queue_push(render_queue);
+        if (command == NULL)
+        {
+          count_geometry(triangles_dropped, 1);
+          return;
+        }
+        count_geometry(triangles_emitted, 1);
+
+        // pack only what the rasterizers need, with u/w, v/w and 1/w divided once per vertex
+        for (int j = 0; j < 3; j++)
+        {
+          float inv_w = 1.0 / projected_points[j].w;
+          float u = triangle_after_clipping.texcoords[j].u;
+          float v = 1.0 - triangle_after_clipping.texcoords[j].v; // flip V component for inverted UV-coordinates
+
+          command->vertices[j] = (raster_vertex_t){
+            .x = projected_points[j].x,
+            .y = projected_points[j].y,
+            .inv_w = inv_w,
+            .u_over_w = u * inv_w,
+            .v_over_w = v * inv_w,
+          };
+        }
+        command->color = triangle_color;
+        command->texture = texture;
       }
     }
   }
 }
 
-void update(void)
+// advance the scene by one simulation step
+void simulate(float step_time)
+{
+  delta_time = step_time;
+  apply_key_presses();
+}
+
+// build the render queue of a frame seen from the given camera
+void update(camera_t camera)
 {
-  uint32_t time_to_wait = FRAME_TARGET_TIME - (SDL_GetTicks() - previous_frame_time);
-  if (time_to_wait > 0 && time_to_wait <= FRAME_TARGET_TIME)
+  view_camera = camera;
+
+  // the raster thread is drawing the previous frame from the other queue meanwhile
+  render_queue = begin_geometry_frame();
+  render_queue_reset(render_queue);
+  update_texture_residency();
+  uint64_t geometry_start = SDL_GetTicksNS();
+
+  meshlet_stats.num_faces = 0;
+  meshlet_stats.num_faces_skipped = 0;
+
+  // view matrix (camera)
+  vec3_t camera_target = vec3_add(view_camera.position, view_camera.direction);
+  vec3_t camera_up_direction = vec3_new(0, 1, 0);
+  view_matrix = mat4_look_at(view_camera.position, camera_target, camera_up_direction);
+
+  // only instances whose bounds touch the frustum reach the pipeline
+  uint64_t query_start = SDL_GetTicksNS();
+  query_visible_instances(view_matrix, &visible_instances);
+  double query_ns = SDL_GetTicksNS() - query_start;
+  instance_visibility_stats.num_visible_sum += array_length(visible_instances);
+  instance_visibility_stats.num_instances_sum += get_num_instances();
+
+  // draw the visible occluders into the occlusion buffer before anything is tested against it
+  uint64_t pass_start = SDL_GetTicksNS();
+  clear_occlusion_buffer();
+  for (int i = 0; i < array_length(visible_instances); i++)
   {
-    SDL_Delay(time_to_wait);
+    instance_t *instance = get_instance(visible_instances[i]);
+    if (instance->is_occluder)
+    {
+      mat4_t world_view_matrix = mat4_mul_mat4(view_matrix, mat4_make_world(instance->scale, instance->rotation, instance->translation));
+      vec3_t camera_model_position = vec3_from_vec4(mat4_mul_vec4(mat4_make_inverse_world(instance->scale, instance->rotation, instance->translation), vec4_from_vec3(view_camera.position)));
+      rasterize_occluder(instance->mesh, world_view_matrix, camera_model_position, is_cull_backface());
+    }
   }
+  double pass_ns = SDL_GetTicksNS() - pass_start;
 
-  delta_time = (SDL_GetTicks() - previous_frame_time) / 1000.0;
+  double culled_faces = 0;
+  frame_clip_ns = 0;
+  occlusion_stats.pipeline_ns = 0;
+  occlusion_stats.pipeline_faces = 0;
 
-  previous_frame_time = SDL_GetTicks();
+  for (int i = 0; i < array_length(visible_instances); i++)
+  {
+    instance_t *instance = get_instance(visible_instances[i]);
 
-  num_triangles_to_render = 0;
+    // change instance rotation / scale / translation per frame with set_instance_transform()
+    // instance.rotation.x += 0.5 * delta_time;
+    // instance.rotation.y += 0.5 * delta_time;
+    // instance.rotation.z += 0.5 * delta_time;
+    // instance.translation.z = 5; // move away object from camera
 
-  for (int i = 0; i < get_num_meshes(); i++)
-  {
-    mesh_t *mesh = get_mesh(i);
+    // skip instances whose bounding sphere is completely behind the occluders
+    if (!instance->is_occluder)
+    {
+      uint64_t test_start = SDL_GetTicksNS();
+      mat4_t world_view_matrix = mat4_mul_mat4(view_matrix, mat4_make_world(instance->scale, instance->rotation, instance->translation));
+      vec3_t center = vec3_from_vec4(mat4_mul_vec4(world_view_matrix, vec4_from_vec3(instance->mesh->bounds_center)));
+      float max_scale = fmaxf(fabsf(instance->scale.x), fmaxf(fabsf(instance->scale.y), fabsf(instance->scale.z)));
+      bool is_occluded = is_sphere_occluded(center, instance->mesh->bounds_radius * max_scale);
+      pass_ns += SDL_GetTicksNS() - test_start;
+
+      occlusion_stats.num_tested_sum++;
+      if (is_occluded)
+      {
+        occlusion_stats.num_culled_sum++;
+        culled_faces += array_length(instance->mesh->lods[instance->current_lod].faces);
+        continue;
+      }
+    }
+
+    uint64_t pipeline_start = SDL_GetTicksNS();
+    process_graphics_pipeline_stages(instance);
+    occlusion_stats.pipeline_ns += SDL_GetTicksNS() - pipeline_start;
+    occlusion_stats.pipeline_faces += array_length(instance->mesh->lods[instance->current_lod].faces);
+  }
 
-    // change mesh rotation / scale / translation per frame
-    // mesh.rotation.x += 0.5 * delta_time;
-    // mesh.rotation.y += 0.5 * delta_time;
-    // mesh.rotation.z += 0.5 * delta_time;
-    // mesh.translation.z = 5; // move away object from camera
+  // estimate what the culled instances would have cost from what the drawn ones did
+  occlusion_stats.pass_ns_sum += pass_ns;
+  if (occlusion_stats.pipeline_faces > 0)
+  {
+    occlusion_stats.saved_ns_sum += culled_faces * occlusion_stats.pipeline_ns / occlusion_stats.pipeline_faces;
+  }
+  occlusion_stats.num_frames++;
 
-    process_graphics_pipeline_stages(mesh);
+  if (meshlet_stats.num_faces > 0)
+  {
+    meshlet_stats.skipped_fraction_sum += (double)meshlet_stats.num_faces_skipped / meshlet_stats.num_faces;
+    meshlet_stats.num_frames++;
   }
+
+  frame_stage_times.geometry_ns_sum += SDL_GetTicksNS() - geometry_start;
+  record_benchmark_sample(BENCHMARK_STAGE_TRANSFORM, occlusion_stats.pipeline_ns - frame_clip_ns);
+  record_benchmark_sample(BENCHMARK_STAGE_CULL, query_ns + pass_ns);
+  record_benchmark_sample(BENCHMARK_STAGE_CLIP, frame_clip_ns);
+
+  // the counts of the frame travel with its queue to the raster thread
+  end_geometry_counters(&render_queue->counters);
+  render_queue->counters.transform_ns = occlusion_stats.pipeline_ns - frame_clip_ns;
+  render_queue->counters.cull_ns = query_ns + pass_ns;
+  render_queue->counters.clip_ns = frame_clip_ns;
 };
 
+// show the newest frame the raster thread finished; frames finished while
+// the previous one was still being presented are skipped
 void render(void)
 {
-  clear_color_buffer(0xFF000000);
-  clear_z_buffer();
+  int color_buffer = acquire_newest_color_buffer();
+  if (color_buffer < 0)
+  {
+    SDL_DelayNS(PRESENT_POLL_NS);
+    return;
+  }
+
+  uint64_t present_start = SDL_GetTicksNS();
+  render_color_buffer(color_buffer);
+  present_color_buffer();
+  double present_ns = SDL_GetTicksNS() - present_start;
+  frame_stage_times.present_ns_sum += present_ns;
+  record_benchmark_sample(BENCHMARK_STAGE_PRESENT, present_ns);
+  if (first_present_ns == 0)
+  {
+    first_present_ns = SDL_GetTicksNS();
+  }
+  if (++num_frames_presented == max_frames_presented)
+  {
+    SDL_SetAtomicInt(&is_running, 0);
+  }
+};
+
+// one benchmark frame from the camera on the path, unpaced
+void draw_benchmark_frame(camera_t camera)
+{
+  begin_frame();
+  update(camera);
+  submit_raster_frame(get_render_method());
+  end_frame(get_last_raster_ns());
+}
 
-  draw_grid();
+// geometry stage loop, handing every frame to the raster thread
+int geometry_thread_main(void *data)
+{
+  (void)data;
 
-  for (int i = 0; i < num_triangles_to_render; i++)
+  if (benchmark_scene != NULL)
   {
-    triangle_t triangle = triangles_to_render[i];
+    run_benchmark(benchmark_path, num_benchmark_frames, draw_benchmark_frame, &is_running);
+    SDL_SetAtomicInt(&is_running, 0);
+    return 0;
+  }
 
-    // draw filled triangle
-    if (should_render_filled_triangles())
-    {
-      draw_filled_triangle(
-        triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, // vertex A
-        triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, // vertex B
-        triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, // vertex C
-        triangle.color
-      );
-    }
+  camera_t previous_camera = get_camera();
+  while (SDL_GetAtomicInt(&is_running))
+  {
+    // the instances whose files finished loading join the scene
+    finish_asset_loads();
 
-    // draw textured triangle
-    if (should_render_textured_triangle())
+    frame_schedule_t schedule = begin_frame();
+    for (int i = 0; i < schedule.num_steps; i++)
     {
-      draw_textured_triangle(
-        triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, triangle.texcoords[0].u, triangle.texcoords[0].v, // vertex A
-        triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, triangle.texcoords[1].u, triangle.texcoords[1].v, // vertex B
-        triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, triangle.texcoords[2].u, triangle.texcoords[2].v, // vertex C
-        triangle.texture
-      );
+      previous_camera = get_camera();
+      simulate(schedule.step_time);
     }
 
-    // draw wireframe
-    if (should_render_wireframe())
-    {
-      draw_triangle(
-        triangle.points[0].x,
-        triangle.points[0].y,
-        triangle.points[1].x,
-        triangle.points[1].y,
-        triangle.points[2].x,
-        triangle.points[2].y,
-        0xFFFFFFFF
-      );
-    }
+    // with fixed steps the frame lies between the last two simulated states
+    update(interpolate_camera(previous_camera, get_camera(), schedule.interpolation));
+    submit_raster_frame(get_render_method());
+
+    // the raster thread can be the slower stage, which the pacing has to follow
+    end_frame(get_last_raster_ns());
+  }
+  return 0;
+}
 
-    // draw the vertex
-    if (should_render_wire_vertex())
+void print_statistics(void)
+{
+  int num_counted_frames;
+  pipeline_counters_t counters = get_pipeline_counters(&num_counted_frames);
+  if (PIPELINE_STATS && counters.faces_in > 0)
+  {
+    double faces_in = counters.faces_in;
+    printf(
+      "faces: %.0f in per frame, %.1f%% backface culled, %.1f%% rejected, %.1f%% accepted, %.1f%% clipped, "
+      "%.0f triangles emitted per frame, %llu dropped\n",
+      faces_in / num_counted_frames,
+      100.0 * counters.faces_backface_culled / faces_in,
+      100.0 * counters.faces_rejected / faces_in,
+      100.0 * counters.faces_accepted / faces_in,
+      100.0 * counters.faces_clipped / faces_in,
+      (double)counters.triangles_emitted / num_counted_frames,
+      (unsigned long long)counters.triangles_dropped
+    );
+  }
+  if (PIPELINE_STATS && counters.pixels_tested > 0)
+  {
+    printf(
+      "pixels: %.0f depth tested per frame, %.1f%% passed, %.0f texels fetched per frame\n",
+      (double)counters.pixels_tested / num_counted_frames,
+      100.0 * counters.pixels_passed / counters.pixels_tested,
+      (double)counters.texels_fetched / num_counted_frames
+    );
+  }
+  if (num_counted_frames > 0)
+  {
+    printf(
+      "stages: transform %.3f ms, cull %.3f ms, clip %.3f ms, raster %.3f ms per frame\n",
+      counters.transform_ns / num_counted_frames / 1e6,
+      counters.cull_ns / num_counted_frames / 1e6,
+      counters.clip_ns / num_counted_frames / 1e6,
+      counters.raster_ns / num_counted_frames / 1e6
+    );
+  }
+
+  if (meshlet_stats.num_frames > 0)
+  {
+    printf(
+      "meshlets: %.1f%% of faces skipped per frame on average\n",
+      100.0 * meshlet_stats.skipped_fraction_sum / meshlet_stats.num_frames
+    );
+  }
+
+  asset_loader_stats_t loader_stats = get_asset_loader_stats();
+  if (loader_stats.num_loaded + loader_stats.num_failed > 0)
+  {
+    printf(
+      "loading: first frame presented %.3f ms after start, %d files loaded on %d threads (%d failed) by %.3f ms after start, %.3f ms of decoding\n",
+      first_present_ns > 0 ? (first_present_ns - program_start_ns) / 1e6 : 0.0,
+      loader_stats.num_loaded,
+      loader_stats.num_threads,
+      loader_stats.num_failed,
+      (loader_stats.last_ready_ns - program_start_ns) / 1e6,
+      loader_stats.decode_ns_sum / 1e6
+    );
+  }
+
+  mesh_load_stats_t mesh_load_stats = get_mesh_load_stats();
+  if (mesh_load_stats.num_cooked + mesh_load_stats.num_parsed > 0)
+  {
+    printf(
+      "meshes: %d mapped from cooked files, %d parsed from OBJ files, %.3f ms loading, "
+      "%.3f vertex cache misses per face in file order and %.3f reordered on average\n",
+      mesh_load_stats.num_cooked,
+      mesh_load_stats.num_parsed,
+      mesh_load_stats.load_ns_sum / 1e6,
+      mesh_load_stats.cache_miss_ratio_before_sum / (mesh_load_stats.num_cooked + mesh_load_stats.num_parsed),
+      mesh_load_stats.cache_miss_ratio_after_sum / (mesh_load_stats.num_cooked + mesh_load_stats.num_parsed)
+    );
+  }
+
+  texture_load_stats_t texture_load_stats = get_texture_load_stats();
+  if (texture_load_stats.num_cooked + texture_load_stats.num_decoded > 0)
+  {
+    printf(
+      "textures: %d mapped from cooked files, %d decoded from PNG files, %.3f ms loading, "
+      "%d compressed to BC1, %.1f KiB of texels sampled for %.1f KiB decoded\n",
+      texture_load_stats.num_cooked,
+      texture_load_stats.num_decoded,
+      texture_load_stats.load_ns_sum / 1e6,
+      texture_load_stats.num_compressed,
+      texture_load_stats.texel_bytes_sum / 1024,
+      texture_load_stats.decoded_texel_bytes_sum / 1024
+    );
+  }
+
+  texture_residency_stats_t texture_residency_stats = get_texture_residency_stats();
+  if (texture_residency_stats.budget_bytes > 0)
+  {
+    printf(
+      "texture residency: %.1f KiB budget, peak of %.1f KiB resident plus %.1f KiB of placeholders, "
+      "%d evicted, %d streamed back in, %.2f%% of %d uses drew the placeholder\n",
+      texture_residency_stats.budget_bytes / 1024,
+      texture_residency_stats.peak_resident_bytes / 1024,
+      texture_residency_stats.placeholder_bytes / 1024,
+      texture_residency_stats.num_evicted,
+      texture_residency_stats.num_streamed_in,
+      texture_residency_stats.num_uses > 0 ? 100.0 * texture_residency_stats.num_placeholder_uses / texture_residency_stats.num_uses : 0,
+      texture_residency_stats.num_uses
+    );
+  }
+
+  if (instance_visibility_stats.num_instances_sum > 0)
+  {
+    printf(
+      "bvh: %.1f%% of %d instances of %d meshes and %d textures inside the view frustum on average\n",
+      100.0 * instance_visibility_stats.num_visible_sum / instance_visibility_stats.num_instances_sum,
+      get_num_instances(),
+      get_num_meshes(),
+      get_num_textures()
+    );
+  }
+
+  if (occlusion_stats.num_frames > 0)
+  {
+    printf(
+      "occlusion: %.1f of %.1f tested instances culled per frame, ~%.3f ms of geometry work saved for %.3f ms spent per frame\n",
+      occlusion_stats.num_culled_sum / occlusion_stats.num_frames,
+      occlusion_stats.num_tested_sum / occlusion_stats.num_frames,
+      occlusion_stats.saved_ns_sum / occlusion_stats.num_frames / 1e6,
+      occlusion_stats.pass_ns_sum / occlusion_stats.num_frames / 1e6
+    );
+  }
+
+  if (vertex_cache_stats.num_lookups > 0)
+  {
+    printf(
+      "vertex cache: %.1f%% of the vertices of drawn faces reused, %.3f welded vertices transformed per face\n",
+      100.0 * vertex_cache_stats.num_hits / vertex_cache_stats.num_lookups,
+      3 * (vertex_cache_stats.num_lookups - vertex_cache_stats.num_hits) / vertex_cache_stats.num_lookups
+    );
+  }
+
+  if (lod_stats.num_full_faces_sum > 0)
+  {
+    printf(
+      "lod: %.1f%% of the full resolution faces submitted on average, %d level switches\n",
+      100.0 * lod_stats.num_lod_faces_sum / lod_stats.num_full_faces_sum,
+      lod_stats.num_lod_switches
+    );
+  }
+
+  frame_time_stats_t frame_stats = get_frame_time_stats();
+  if (frame_stats.num_frames > 0)
+  {
+    printf(
+      "frames: %d %s at %d fps, frame time mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms, %.3f ms of work per frame",
+      frame_stats.num_frames,
+      get_frame_schedule_mode_name(schedule_mode),
+      target_fps,
+      frame_stats.mean_ms,
+      frame_stats.p50_ms,
+      frame_stats.p99_ms,
+      frame_stats.max_ms,
+      frame_stats.mean_work_ms
+    );
+    if (schedule_mode == FRAME_SCHEDULE_ADAPTIVE)
     {
-      draw_rect(triangle.points[0].x - 3, triangle.points[0].y - 3, 6, 6, 0xFFFF0000);
-      draw_rect(triangle.points[1].x - 3, triangle.points[1].y - 3, 6, 6, 0xFFFF0000);
-      draw_rect(triangle.points[2].x - 3, triangle.points[2].y - 3, 6, 6, 0xFFFF0000);
+      printf(", paced at %d fps at the end", target_fps / frame_stats.rate_divisor);
     }
+    printf("\n");
   }
 
-  render_color_buffer();
-};
+  raster_thread_stats_t raster_stats = get_raster_thread_stats();
+  if (raster_stats.num_frames > 0)
+  {
+    printf(
+      "pipeline: geometry %.3f ms + raster %.3f ms per frame in sequence, %.3f ms per frame overlapped; "
+      "geometry waited %.3f ms and raster %.3f ms per frame\n",
+      frame_stage_times.geometry_ns_sum / raster_stats.num_frames / 1e6,
+      raster_stats.raster_ns_sum / raster_stats.num_frames / 1e6,
+      frame_stats.mean_work_ms,
+      raster_stats.wait_ns_sum / raster_stats.num_frames / 1e6,
+      raster_stats.raster_idle_ns_sum / raster_stats.num_frames / 1e6
+    );
+  }
+
+  if (raster_stats.num_frames_presented > 0)
+  {
+    printf(
+      "present: %d of %d frames presented, %d replaced by newer ones, %.3f ms upload and present per frame on the main thread\n",
+      raster_stats.num_frames_presented,
+      raster_stats.num_frames,
+      raster_stats.num_frames_dropped,
+      frame_stage_times.present_ns_sum / raster_stats.num_frames_presented / 1e6
+    );
+  }
+
+  printf(
+    "render queue: peak of %d commands per frame, frame arena peak %zu KiB of %zu KiB reserved\n",
+    raster_stats.high_water,
+    raster_stats.arena_high_water / 1024,
+    raster_stats.arena_capacity / 1024
+  );
+}
 
 void free_resources(void)
 {
+  for (int i = 0; i < array_length(pending_instances); i++)
+  {
+    release_mesh(pending_instances[i]->mesh);
+    release_texture(pending_instances[i]->texture);
+    free(pending_instances[i]);
+  }
+  array_free(pending_instances);
+  array_free(visible_instances);
+  free_occlusion_buffer();
+  free_instances();
   free_meshes();
+  free_textures();
+  free_frame_scheduler();
+  free_benchmark();
   destroy_window();
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
-  is_running = initialize_window();
+  program_start_ns = SDL_GetTicksNS();
 
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+    {
+      num_grid_instances = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--schedule") == 0 && i + 1 < argc)
+    {
+      if (!parse_frame_schedule_mode(argv[++i], &schedule_mode))
+      {
+        fprintf(stderr, "Error: unknown frame schedule '%s', expected uncapped, fixed or adaptive.\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--obj-benchmark") == 0 && i + 1 < argc)
+    {
+      benchmark_obj_loaders(argc - i - 1, &argv[i + 1]);
+      return 0;
+    }
+    else if (strcmp(argv[i], "--texture-benchmark") == 0 && i + 1 < argc)
+    {
+      benchmark_texture_formats(argc - i - 1, &argv[i + 1]);
+      return 0;
+    }
+    else if (strcmp(argv[i], "--texture-format") == 0 && i + 1 < argc)
+    {
+      int texture_format;
+      if (!parse_texture_format(argv[++i], &texture_format))
+      {
+        fprintf(stderr, "Error: unknown texture format '%s', expected rgba32 or bc1.\n", argv[i]);
+        return 1;
+      }
+      set_texture_format(texture_format);
+    }
+    else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+    {
+      int budget_kib = atoi(argv[++i]);
+      if (budget_kib <= 0)
+      {
+        fprintf(stderr, "Error: --texture-budget needs a positive size in KiB.\n");
+        return 1;
+      }
+      set_texture_budget((size_t)budget_kib * 1024);
+    }
+    else if (strcmp(argv[i], "--display") == 0 && i + 1 < argc)
+    {
+      int display_backend;
+      if (!parse_display_backend(argv[++i], &display_backend))
+      {
+        fprintf(stderr, "Error: unknown display '%s', expected sdl or headless.\n", argv[i]);
+        return 1;
+      }
+      set_display_backend(display_backend);
+    }
+    else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc)
+    {
+      int width, height;
+      if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+      {
+        fprintf(stderr, "Error: --resolution needs a size such as 800x600.\n");
+        return 1;
+      }
+      set_display_resolution(width, height);
+    }
+    else if (strcmp(argv[i], "--dump-frames") == 0 && i + 2 < argc)
+    {
+      int interval = atoi(argv[++i]);
+      if (interval <= 0)
+      {
+        fprintf(stderr, "Error: --dump-frames needs a positive frame interval.\n");
+        return 1;
+      }
+      set_frame_dump(argv[++i], interval);
+    }
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+    {
+      max_frames_presented = atoi(argv[++i]);
+      if (max_frames_presented <= 0)
+      {
+        fprintf(stderr, "Error: --frames needs a positive frame count.\n");
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--render-method") == 0 && i + 1 < argc)
+    {
+      if (!parse_render_method(argv[++i], &initial_render_method))
+      {
+        fprintf(stderr, "Error: unknown render method '%s', expected wire, wire-vertex, filled, filled-wire, textured or textured-wire.\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+    {
+      benchmark_scene = argv[++i];
+      bool is_known = false;
+      for (int j = 0; j < (int)(sizeof(benchmark_scenes) / sizeof(benchmark_scenes[0])); j++)
+      {
+        is_known = is_known || strcmp(benchmark_scene, benchmark_scenes[j]) == 0;
+      }
+      if (!is_known)
+      {
+        fprintf(stderr, "Error: unknown benchmark scene '%s', expected cube, f22, efa, f117, crab, drone, runway or grid.\n", benchmark_scene);
+        return 1;
+      }
+
+      // frames back to back unless a schedule is given after it
+      schedule_mode = FRAME_SCHEDULE_UNCAPPED;
+    }
+    else if (strcmp(argv[i], "--benchmark-path") == 0 && i + 1 < argc)
+    {
+      if (!parse_benchmark_path(argv[++i], &benchmark_path))
+      {
+        fprintf(stderr, "Error: unknown benchmark path '%s', expected orbit or dolly.\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--benchmark-frames") == 0 && i + 1 < argc)
+    {
+      num_benchmark_frames = atoi(argv[++i]);
+      if (num_benchmark_frames <= 0)
+      {
+        fprintf(stderr, "Error: --benchmark-frames needs a positive frame count.\n");
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--benchmark-json") == 0 && i + 1 < argc)
+    {
+      benchmark_json_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--pipeline-log") == 0)
+    {
+      set_pipeline_log(true);
+    }
+    else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+    {
+      target_fps = atoi(argv[++i]);
+      if (target_fps <= 0)
+      {
+        fprintf(stderr, "Error: --fps needs a positive frame rate.\n");
+        return 1;
+      }
+    }
+    else
+    {
+      // also reached by a known option missing its values at the end
+      fprintf(stderr, "Error: unknown option '%s' or missing value.\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (benchmark_scene != NULL && strcmp(benchmark_scene, "grid") == 0 && num_grid_instances == 0)
+  {
+    num_grid_instances = BENCHMARK_GRID_INSTANCES;
+  }
+
+  SDL_SetAtomicInt(&is_running, initialize_window());
+
+  // the loader threads start first, so files load while the window and the
+  // other threads come up
+  start_asset_loader();
   setup();
 
-  while (is_running)
+  // the main thread only polls events and presents, geometry and
+  // rasterization run on their own threads
+  SDL_Thread *geometry_thread = NULL;
+  if (SDL_GetAtomicInt(&is_running) && start_raster_thread(INITIAL_RENDER_QUEUE_CAPACITY))
+  {
+    geometry_thread = SDL_CreateThread(geometry_thread_main, "geometry", NULL);
+    if (geometry_thread == NULL)
+    {
+      fprintf(stderr, "Error: SDL_CreateThread(): %s.\n", SDL_GetError());
+    }
+  }
+  if (geometry_thread == NULL)
+  {
+    SDL_SetAtomicInt(&is_running, 0);
+  }
+
+  while (SDL_GetAtomicInt(&is_running))
   {
     process_input();
-    update();
     render();
   }
 
+  SDL_WaitThread(geometry_thread, NULL);
+  stop_raster_thread();
+  stop_asset_loader();
+  stop_benchmark_recording();
+
+  print_statistics();
+  if (benchmark_scene != NULL)
+  {
+    benchmark_run_t run = {
+      .scene = benchmark_scene,
+      .path = benchmark_path,
+      .width = get_window_width(),
+      .height = get_window_height(),
+      .render_method = get_render_method_name(initial_render_method),
+      .num_frames = num_benchmark_frames,
+      .num_instances = get_num_instances(),
+    };
+    report_benchmark(&run, benchmark_json_path);
+  }
   free_resources();
 
   return 0;
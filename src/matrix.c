@@ -178,3 +178,41 @@ mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up)
 
   return view_matrix;
 }
+
+mat4_t mat4_make_world(vec3_t scale, vec3_t rotation, vec3_t translation)
+{
+  // order matters: scale - rotation - translation
+  mat4_t m = mat4_make_scale(scale.x, scale.y, scale.z);
+  m = mat4_mul_mat4(mat4_make_rotation_z(rotation.z), m);
+  m = mat4_mul_mat4(mat4_make_rotation_y(rotation.y), m);
+  m = mat4_mul_mat4(mat4_make_rotation_x(rotation.x), m);
+  m = mat4_mul_mat4(mat4_make_translation(translation.x, translation.y, translation.z), m);
+
+  return m;
+}
+
+mat4_t mat4_make_inverse_world(vec3_t scale, vec3_t rotation, vec3_t translation)
+{
+  // inverse of translation * rotation_x * rotation_y * rotation_z * scale,
+  // undoing each step in reverse order
+  mat4_t m = mat4_make_translation(-translation.x, -translation.y, -translation.z);
+  m = mat4_mul_mat4(mat4_make_rotation_x(-rotation.x), m);
+  m = mat4_mul_mat4(mat4_make_rotation_y(-rotation.y), m);
+  m = mat4_mul_mat4(mat4_make_rotation_z(-rotation.z), m);
+  m = mat4_mul_mat4(mat4_make_scale(1.0 / scale.x, 1.0 / scale.y, 1.0 / scale.z), m);
+
+  return m;
+}
+
+mat4_t mat4_transpose(mat4_t m)
+{
+  mat4_t result;
+  for (int i = 0; i < 4; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      result.m[i][j] = m.m[j][i];
+    }
+  }
+  return result;
+}
@@ -1,120 +1,358 @@
 #include "mesh.h"
 #include "array.h"
+#include "asset.h"
+#include "asset_loader.h"
+#include "cooked_mesh.h"
+#include "obj_parser.h"
+#include "simplify.h"
 #include "texture.h"
 #include "triangle.h"
-#include "upng.h"
+#include "vertex_cache.h"
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define MAX_NUM_MESHES 10
-static mesh_t meshes[MAX_NUM_MESHES];
-static int mesh_count = 0;
+// projected bounding sphere radius in pixels below which a mesh switches to
+// the next coarser level; a level is only left again once the radius moved
+// LOD_HYSTERESIS past its threshold, so meshes do not flicker between levels
+static const float lod_screen_radius[MAX_NUM_MESH_LODS - 1] = {120, 60, 30};
+#define LOD_HYSTERESIS 0.15
 
-void load_mesh(char *obj_filename, char *png_filename, vec3_t scale, vec3_t translation, vec3_t rotation)
-{
-  load_mesh_obj_data(&meshes[mesh_count], obj_filename);
-  load_mesh_png_data(&meshes[mesh_count], png_filename);
+// stop generating levels once simplification removes less than this fraction
+#define LOD_MIN_REDUCTION 0.1
+#define LOD_MIN_FACES 32
 
-  meshes[mesh_count].scale = scale;
-  meshes[mesh_count].translation = translation;
-  meshes[mesh_count].rotation = rotation;
+static mesh_load_stats_t load_stats;
 
-  mesh_count++;
+void load_mesh_obj_data(mesh_t *mesh, const char *obj_data, size_t size)
+{
+  parse_obj(obj_data, size, &mesh->vertices, &mesh->lods[0].faces);
+  build_mesh_lods(mesh);
 }
 
-void load_mesh_obj_data(mesh_t *mesh, char *obj_filename)
+static void compute_lod_face_planes(mesh_lod_t *lod, vec3_t *vertices)
 {
-  FILE *fp = fopen(obj_filename, "r");
-  if (fp == NULL)
+  int num_faces = array_length(lod->faces);
+  for (int i = 0; i < num_faces; i++)
   {
-    perror("Error opening obj file");
-    return;
+    vec3_t vector_a = vertices[lod->faces[i].a];
+    vec3_t vector_b = vertices[lod->faces[i].b];
+    vec3_t vector_c = vertices[lod->faces[i].c];
+
+    // same winding as get_triangle_normal(): normal = (B-A) x (C-A)
+    vec3_t vector_ab = vec3_sub(vector_b, vector_a);
+    vec3_t vector_ac = vec3_sub(vector_c, vector_a);
+    vec3_normalize(&vector_ab);
+    vec3_normalize(&vector_ac);
+
+    vec3_t normal = vec3_cross(vector_ab, vector_ac);
+    vec3_normalize(&normal);
+
+    face_plane_t face_plane = {
+      .normal = normal,
+      .distance = vec3_dot(normal, vector_a),
+    };
+    array_push(lod->face_planes, face_plane);
   }
+}
 
-  tex2_t *texcoords = NULL;
+static meshlet_t make_meshlet(mesh_lod_t *lod, vec3_t *vertices, int first_face, int num_faces)
+{
+  meshlet_t meshlet = {
+    .first_face = first_face,
+    .num_faces = num_faces,
+  };
 
-  char buff[512];
-  while (fgets(buff, 512, fp))
+  // bounding sphere around the center of the meshlet bounding box
+  vec3_t min = vertices[lod->faces[first_face].a];
+  vec3_t max = min;
+  vec3_t normal_sum = vec3_new(0, 0, 0);
+  for (int i = first_face; i < first_face + num_faces; i++)
   {
-    // vertex information
-    if (buff[0] == 'v' && buff[1] == ' ')
+    int indices[3] = {lod->faces[i].a, lod->faces[i].b, lod->faces[i].c};
+    for (int j = 0; j < 3; j++)
     {
-      vec3_t vertex;
-      sscanf(buff, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-      array_push(mesh->vertices, vertex);
-      continue;
+      vec3_t v = vertices[indices[j]];
+      min = vec3_new(fminf(min.x, v.x), fminf(min.y, v.y), fminf(min.z, v.z));
+      max = vec3_new(fmaxf(max.x, v.x), fmaxf(max.y, v.y), fmaxf(max.z, v.z));
     }
+    normal_sum = vec3_add(normal_sum, lod->face_planes[i].normal);
+  }
 
-    // texture coordinate information
-    if (strncmp(buff, "vt", 2) == 0)
+  meshlet.center = vec3_mul(vec3_add(min, max), 0.5);
+  for (int i = first_face; i < first_face + num_faces; i++)
+  {
+    int indices[3] = {lod->faces[i].a, lod->faces[i].b, lod->faces[i].c};
+    for (int j = 0; j < 3; j++)
     {
-      tex2_t texcoord;
-      sscanf(buff, "vt %f %f", &texcoord.u, &texcoord.v);
-      array_push(texcoords, texcoord);
-      continue;
+      float distance = vec3_length(vec3_sub(vertices[indices[j]], meshlet.center));
+      meshlet.radius = fmaxf(meshlet.radius, distance);
     }
+  }
 
-    // face information
-    if (buff[0] == 'f' && buff[1] == ' ')
+  // normal cone: the widest angle between the average normal and any face normal
+  meshlet.cone_sin = 1;
+  if (vec3_length(normal_sum) > 0.0001f)
+  {
+    meshlet.cone_axis = normal_sum;
+    vec3_normalize(&meshlet.cone_axis);
+
+    float min_cos = 1;
+    for (int i = first_face; i < first_face + num_faces; i++)
     {
-      int vertex_indices[3];
-      int texture_indices[3];
-      int normal_indices[3];
-      sscanf(
-        buff,
-        "f %d/%d/%d %d/%d/%d %d/%d/%d",
-        &vertex_indices[0], &texture_indices[0], &normal_indices[0],
-        &vertex_indices[1], &texture_indices[1], &normal_indices[1],
-        &vertex_indices[2], &texture_indices[2], &normal_indices[2]
-      );
-
-      face_t face = {
-        .a = vertex_indices[0] - 1,
-        .b = vertex_indices[1] - 1,
-        .c = vertex_indices[2] - 1,
-        .a_uv = texcoords[texture_indices[0] - 1],
-        .b_uv = texcoords[texture_indices[1] - 1],
-        .c_uv = texcoords[texture_indices[2] - 1],
-        .color = 0xFFFFFFFF,
-      };
-      array_push(mesh->faces, face);
-      continue;
+      min_cos = fminf(min_cos, vec3_dot(meshlet.cone_axis, lod->face_planes[i].normal));
+    }
+
+    // a cone of 90 degrees or more always has some face towards the camera
+    if (min_cos > 0)
+    {
+      meshlet.cone_sin = sqrtf(1 - min_cos * min_cos);
     }
   }
 
-  array_free(texcoords);
-  fclose(fp);
+  return meshlet;
 }
 
-void load_mesh_png_data(mesh_t *mesh, char *png_filename)
+// order the faces so consecutive ones share vertices; the fans the order is
+// made of grow outwards from each other, so runs of faces are spatially close
+// and the meshlets cut from them stay small
+static void order_lod_faces_for_vertex_cache(mesh_lod_t *lod)
 {
-  upng_t *png_image = upng_new_from_file(png_filename);
-  if (png_image != NULL)
+  int num_faces = array_length(lod->faces);
+  int *face_order = (int *)malloc(sizeof(int) * num_faces);
+  face_t *faces = (face_t *)malloc(sizeof(face_t) * num_faces);
+  uint32_t *indices = (uint32_t *)malloc(sizeof(uint32_t) * num_faces * 3);
+  if (num_faces == 0 || face_order == NULL || faces == NULL || indices == NULL)
   {
-    upng_decode(png_image);
-    if (upng_get_error(png_image) == UPNG_EOK)
+    free(face_order);
+    free(faces);
+    free(indices);
+    return;
+  }
+
+  // out of memory keeps the faces in file order
+  if (!order_faces_for_vertex_cache(lod->indices, num_faces, face_order))
+  {
+    free(face_order);
+    free(faces);
+    free(indices);
+    return;
+  }
+
+  memcpy(faces, lod->faces, sizeof(face_t) * num_faces);
+  memcpy(indices, lod->indices, sizeof(uint32_t) * num_faces * 3);
+  for (int i = 0; i < num_faces; i++)
+  {
+    lod->faces[i] = faces[face_order[i]];
+    memcpy(&lod->indices[i * 3], &indices[face_order[i] * 3], sizeof(uint32_t) * 3);
+  }
+
+  free(face_order);
+  free(faces);
+  free(indices);
+}
+
+static void build_lod_meshlets(mesh_t *mesh, mesh_lod_t *lod, vertex_weld_table_t *weld_table)
+{
+  vec3_t *vertices = mesh->vertices;
+  lod->indices = weld_face_vertices(weld_table, &mesh->welded_vertices, vertices, lod->faces);
+  order_lod_faces_for_vertex_cache(lod);
+  compute_lod_face_planes(lod, vertices);
+
+  int num_faces = array_length(lod->faces);
+  for (int first_face = 0; first_face < num_faces; first_face += MESHLET_MAX_FACES)
+  {
+    int num_meshlet_faces = num_faces - first_face < MESHLET_MAX_FACES ? num_faces - first_face : MESHLET_MAX_FACES;
+    meshlet_t meshlet = make_meshlet(lod, vertices, first_face, num_meshlet_faces);
+    array_push(lod->meshlets, meshlet);
+  }
+}
+
+static void compute_mesh_bounds(mesh_t *mesh)
+{
+  int num_vertices = array_length(mesh->vertices);
+  if (num_vertices == 0)
+  {
+    return;
+  }
+
+  vec3_t min = mesh->vertices[0];
+  vec3_t max = min;
+  for (int i = 1; i < num_vertices; i++)
+  {
+    vec3_t v = mesh->vertices[i];
+    min = vec3_new(fminf(min.x, v.x), fminf(min.y, v.y), fminf(min.z, v.z));
+    max = vec3_new(fmaxf(max.x, v.x), fmaxf(max.y, v.y), fmaxf(max.z, v.z));
+  }
+
+  mesh->bounds_center = vec3_mul(vec3_add(min, max), 0.5);
+  mesh->bounds_radius = 0;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    mesh->bounds_radius = fmaxf(mesh->bounds_radius, vec3_length(vec3_sub(mesh->vertices[i], mesh->bounds_center)));
+  }
+}
+
+void build_mesh_lods(mesh_t *mesh)
+{
+  compute_mesh_bounds(mesh);
+
+  // weld the file order first, so the welded vertices keep the order of the
+  // file and the cache misses of that order can be compared against
+  vertex_weld_table_t weld_table = {0};
+  uint32_t *file_order_indices = weld_face_vertices(&weld_table, &mesh->welded_vertices, mesh->vertices, mesh->lods[0].faces);
+  mesh->cache_miss_ratio_before = get_vertex_cache_miss_ratio(file_order_indices, array_length(mesh->lods[0].faces));
+  array_free(file_order_indices);
+
+  // every coarser level is simplified from the previous one
+  mesh->num_lods = 1;
+  while (mesh->num_lods < MAX_NUM_MESH_LODS)
+  {
+    face_t *faces = mesh->lods[mesh->num_lods - 1].faces;
+    int num_faces = array_length(faces);
+    if (num_faces < LOD_MIN_FACES * 2)
+    {
+      break;
+    }
+
+    // out of memory keeps the levels built so far
+    face_t *simplified = simplify_faces(mesh->vertices, faces, num_faces / 2);
+    if (simplified == NULL || array_length(simplified) > num_faces * (1 - LOD_MIN_REDUCTION))
     {
-      mesh->texture = png_image;
+      array_free(simplified);
+      break;
     }
+
+    mesh->lods[mesh->num_lods].faces = simplified;
+    mesh->num_lods++;
+  }
+
+  for (int i = 0; i < mesh->num_lods; i++)
+  {
+    build_lod_meshlets(mesh, &mesh->lods[i], &weld_table);
   }
+  free_vertex_weld_table(&weld_table);
+  mesh->cache_miss_ratio_after = get_vertex_cache_miss_ratio(mesh->lods[0].indices, array_length(mesh->lods[0].faces));
 }
 
-int get_num_meshes(void)
+int select_mesh_lod(mesh_t *mesh, int lod, float screen_radius)
 {
-  return mesh_count;
+  // coarser while the mesh is clearly smaller than the threshold of the current level
+  while (lod + 1 < mesh->num_lods && screen_radius < lod_screen_radius[lod] * (1 - LOD_HYSTERESIS))
+  {
+    lod++;
+  }
+
+  // finer while the mesh is clearly larger than the threshold that led to the current level
+  while (lod > 0 && screen_radius > lod_screen_radius[lod - 1] * (1 + LOD_HYSTERESIS))
+  {
+    lod--;
+  }
+
+  return lod;
 }
 
-mesh_t *get_mesh(int index)
+bool is_meshlet_backfacing(meshlet_t *meshlet, vec3_t camera_model_position)
 {
-  return &meshes[index];
+  // every face is back-facing when the direction from the camera to any point of the
+  // bounding sphere is within 90 degrees minus the cone half-angle of the cone axis
+  vec3_t camera_to_center = vec3_sub(meshlet->center, camera_model_position);
+  float distance = vec3_length(camera_to_center);
+  return vec3_dot(meshlet->cone_axis, camera_to_center) - meshlet->radius > meshlet->cone_sin * (distance + meshlet->radius);
 }
 
-void free_meshes(void)
+static void *load_mesh_asset(const char *path, const unsigned char *bytes, size_t size, uint64_t content_hash)
 {
-  for (int i = 0; i < mesh_count; i++)
+  mesh_t *mesh = (mesh_t *)calloc(1, sizeof(mesh_t));
+  if (mesh == NULL)
   {
-    upng_free(meshes[i].texture);
-    array_free(meshes[i].faces);
-    array_free(meshes[i].vertices);
+    return NULL;
   }
+
+  // a cooked file of these exact OBJ bytes is mapped as is, anything else is parsed
+  char cooked_path[1024];
+  if (!get_cooked_mesh_path(path, cooked_path, sizeof(cooked_path)) || !load_cooked_mesh(mesh, cooked_path, content_hash))
+  {
+    load_mesh_obj_data(mesh, (const char *)bytes, size);
+  }
+  return mesh;
+}
+
+static void free_mesh_asset(void *data)
+{
+  mesh_t *mesh = (mesh_t *)data;
+
+  // cooked arrays live in the mapping
+  if (mesh->cooked_data != NULL)
+  {
+    unmap_file(mesh->cooked_data, mesh->cooked_size);
+    free(mesh);
+    return;
+  }
+
+  for (int i = 0; i < mesh->num_lods; i++)
+  {
+    array_free(mesh->lods[i].faces);
+    array_free(mesh->lods[i].face_planes);
+    array_free(mesh->lods[i].meshlets);
+    array_free(mesh->lods[i].indices);
+  }
+  array_free(mesh->vertices);
+  array_free(mesh->welded_vertices);
+  free(mesh);
+}
+
+// runs on the thread owning the registry, also for meshes decoded on other threads
+static void record_mesh_load(void *data, uint64_t load_ns)
+{
+  mesh_t *mesh = (mesh_t *)data;
+  if (mesh->cooked_data != NULL)
+  {
+    load_stats.num_cooked++;
+  }
+  else
+  {
+    load_stats.num_parsed++;
+  }
+  load_stats.load_ns_sum += load_ns;
+  load_stats.cache_miss_ratio_before_sum += mesh->cache_miss_ratio_before;
+  load_stats.cache_miss_ratio_after_sum += mesh->cache_miss_ratio_after;
+}
+
+static asset_registry_t mesh_registry = {
+  .load = load_mesh_asset,
+  .free = free_mesh_asset,
+  .loaded = record_mesh_load,
+};
+
+mesh_t *load_mesh(char *obj_filename)
+{
+  return (mesh_t *)asset_acquire(&mesh_registry, obj_filename);
+}
+
+void load_mesh_async(char *obj_filename, asset_ready_t on_ready, void *user_data)
+{
+  load_asset_async(&mesh_registry, obj_filename, on_ready, user_data);
+}
+
+void release_mesh(mesh_t *mesh)
+{
+  asset_release(&mesh_registry, mesh);
+}
+
+int get_num_meshes(void)
+{
+  return asset_count(&mesh_registry);
+}
+
+mesh_load_stats_t get_mesh_load_stats(void)
+{
+  return load_stats;
+}
+
+void free_meshes(void)
+{
+  asset_registry_free(&mesh_registry);
 }
@@ -0,0 +1,592 @@
+#include "obj_parser.h"
+#include "array.h"
+#include "asset.h"
+#include "triangle.h"
+#include "vector.h"
+#include <SDL3/SDL.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// runs of each parser when timing OBJ loading, the fastest one counts
+#define OBJ_BENCHMARK_RUNS 10
+
+// mantissa digits are only added up to this, so mantissa * 10 + 9 never goes
+// past 2^53 and the mantissa stays exact in a double
+#define MAX_EXACT_MANTISSA (((1ULL << 53) - 9) / 10)
+
+// exponents past this overflow or underflow any float, larger ones are clamped
+#define MAX_EXPONENT 1000
+
+// powers of ten that are exact in a double
+static const double exact_powers_of_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+#define MAX_EXACT_POWER_OF_TEN 22
+
+// face corner references before the chunks are merged: a relative index
+// counts from the start of its chunk, an absolute one from the start of the file
+#define OBJ_NO_TEXCOORD -1
+typedef struct
+{
+  int vertex[3];
+  int texcoord[3];
+  uint8_t relative_mask; // bits 0-2 relative vertex, 3-5 relative texcoord
+  bool is_valid;
+} obj_face_t;
+
+typedef struct
+{
+  int vertex;
+  int texcoord;
+  bool is_vertex_relative;
+  bool is_texcoord_relative;
+} obj_corner_t;
+
+typedef struct
+{
+  const char *begin;
+  const char *end;
+  vec3_t *vertices;
+  tex2_t *texcoords;
+  obj_face_t *faces;
+  SDL_Thread *thread;
+} obj_chunk_t;
+
+static bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// spaces, tabs and the carriage return of CRLF line ends
+static const char *skip_spaces(const char *p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+  {
+    p++;
+  }
+  return p;
+}
+
+static const char *skip_line(const char *p, const char *end)
+{
+  const char *newline = memchr(p, '\n', end - p);
+  return newline != NULL ? newline + 1 : end;
+}
+
+static bool is_line_end(const char *p, const char *end)
+{
+  return p == end || *p == '\n' || *p == '#';
+}
+
+// returns p unchanged when there is no number
+static const char *scan_int(const char *p, const char *end, int *value)
+{
+  const char *start = p;
+  bool is_negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    is_negative = *p == '-';
+    p++;
+  }
+  if (p == end || !is_digit(*p))
+  {
+    return start;
+  }
+
+  // a malformed file can have any number of digits, the value saturates
+  int result = 0;
+  while (p < end && is_digit(*p))
+  {
+    int digit = *p - '0';
+    result = result > (INT_MAX - digit) / 10 ? INT_MAX : result * 10 + digit;
+    p++;
+  }
+  *value = is_negative ? -result : result;
+  return p;
+}
+
+// decimal mantissa and exponent scaled with exact powers of ten where
+// possible; returns p unchanged when there is no number
+static const char *scan_float(const char *p, const char *end, float *value)
+{
+  const char *start = p;
+  bool is_negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    is_negative = *p == '-';
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int num_digits = 0;
+  while (p < end && is_digit(*p))
+  {
+    if (mantissa <= MAX_EXACT_MANTISSA)
+      mantissa = mantissa * 10 + (*p - '0');
+    else
+      exponent++;
+    num_digits++;
+    p++;
+  }
+  if (p < end && *p == '.')
+  {
+    p++;
+    while (p < end && is_digit(*p))
+    {
+      if (mantissa <= MAX_EXACT_MANTISSA)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+      num_digits++;
+      p++;
+    }
+  }
+  if (num_digits == 0)
+  {
+    return start;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    int explicit_exponent;
+    const char *after_exponent = scan_int(p + 1, end, &explicit_exponent);
+    if (after_exponent != p + 1)
+    {
+      exponent += explicit_exponent < -MAX_EXPONENT ? -MAX_EXPONENT : explicit_exponent > MAX_EXPONENT ? MAX_EXPONENT : explicit_exponent;
+      p = after_exponent;
+    }
+  }
+
+  double result = (double)mantissa;
+  if (exponent >= 0 && exponent <= MAX_EXACT_POWER_OF_TEN)
+    result *= exact_powers_of_ten[exponent];
+  else if (exponent < 0 && exponent >= -MAX_EXACT_POWER_OF_TEN)
+    result /= exact_powers_of_ten[-exponent];
+  else
+    result *= pow(10.0, exponent);
+
+  *value = is_negative ? -result : result;
+  return p;
+}
+
+// one face corner, v, v/vt, v//vn or v/vt/vn; OBJ indices start at 1 and
+// negative ones count back from the last element read so far
+static const char *scan_corner(const char *p, const char *end, obj_corner_t *corner, int num_vertices, int num_texcoords, bool *is_valid)
+{
+  corner->vertex = 0;
+  corner->texcoord = OBJ_NO_TEXCOORD;
+  corner->is_vertex_relative = false;
+  corner->is_texcoord_relative = false;
+
+  // skip a corner that does not start with a number
+  int index = 0;
+  const char *after = scan_int(p, end, &index);
+  if (after == p)
+  {
+    *is_valid = false;
+    while (!is_line_end(p, end) && *p != ' ' && *p != '\t' && *p != '\r')
+    {
+      p++;
+    }
+    return p;
+  }
+  p = after;
+  corner->is_vertex_relative = index < 0;
+  corner->vertex = index < 0 ? num_vertices + index : index - 1;
+  *is_valid = *is_valid && index != 0;
+
+  if (p < end && *p == '/')
+  {
+    p++;
+    after = scan_int(p, end, &index);
+    if (after != p)
+    {
+      p = after;
+      corner->is_texcoord_relative = index < 0;
+      corner->texcoord = index < 0 ? num_texcoords + index : index - 1;
+      *is_valid = *is_valid && index != 0;
+    }
+
+    // the normal index is not used
+    if (p < end && *p == '/')
+    {
+      p = scan_int(p + 1, end, &index);
+    }
+  }
+  return p;
+}
+
+static void push_face(obj_chunk_t *chunk, obj_corner_t corners[3], bool is_valid)
+{
+  obj_face_t face = {.is_valid = is_valid};
+  for (int i = 0; i < 3; i++)
+  {
+    face.vertex[i] = corners[i].vertex;
+    face.texcoord[i] = corners[i].texcoord;
+    face.relative_mask |= corners[i].is_vertex_relative << i;
+    face.relative_mask |= corners[i].is_texcoord_relative << (i + 3);
+  }
+  array_push(chunk->faces, face);
+}
+
+static void parse_chunk(obj_chunk_t *chunk)
+{
+  const char *p = chunk->begin;
+  const char *end = chunk->end;
+  while (p < end)
+  {
+    p = skip_spaces(p, end);
+    if (end - p < 2)
+    {
+      break;
+    }
+
+    // vertex information
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+    {
+      vec3_t vertex = {0, 0, 0};
+      p = scan_float(skip_spaces(p + 2, end), end, &vertex.x);
+      p = scan_float(skip_spaces(p, end), end, &vertex.y);
+      p = scan_float(skip_spaces(p, end), end, &vertex.z);
+      array_push(chunk->vertices, vertex);
+    }
+    // texture coordinate information, v is optional
+    else if (p[0] == 'v' && p[1] == 't')
+    {
+      tex2_t texcoord = {0, 0};
+      p = scan_float(skip_spaces(p + 2, end), end, &texcoord.u);
+      p = scan_float(skip_spaces(p, end), end, &texcoord.v);
+      array_push(chunk->texcoords, texcoord);
+    }
+    // face information, polygons are fanned out from their first corner
+    else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+    {
+      int num_vertices = array_length(chunk->vertices);
+      int num_texcoords = array_length(chunk->texcoords);
+      obj_corner_t corners[3];
+      int num_corners = 0;
+      bool is_valid = true;
+
+      p = skip_spaces(p + 2, end);
+      while (!is_line_end(p, end))
+      {
+        obj_corner_t corner;
+        p = scan_corner(p, end, &corner, num_vertices, num_texcoords, &is_valid);
+        p = skip_spaces(p, end);
+
+        if (num_corners < 3)
+        {
+          corners[num_corners++] = corner;
+        }
+        else
+        {
+          corners[1] = corners[2];
+          corners[2] = corner;
+        }
+        if (num_corners == 3)
+        {
+          push_face(chunk, corners, is_valid);
+        }
+      }
+    }
+
+    p = skip_line(p, end);
+  }
+}
+
+static int parse_chunk_thread(void *data)
+{
+  parse_chunk((obj_chunk_t *)data);
+  return 0;
+}
+
+// resolve a reference against the merged arrays, -1 when it does not exist
+static int resolve_index(int index, bool is_relative, int chunk_base, int count)
+{
+  if (is_relative)
+  {
+    index += chunk_base;
+  }
+  return index >= 0 && index < count ? index : -1;
+}
+
+int parse_obj(const char *data, size_t size, vec3_t **vertices, face_t **faces)
+{
+  // split at line ends, so no line is cut between two chunks
+  int num_chunks = size / OBJ_MIN_CHUNK_SIZE;
+  int num_cores = SDL_GetNumLogicalCPUCores();
+  if (num_chunks > num_cores)
+    num_chunks = num_cores;
+  if (num_chunks > OBJ_MAX_CHUNKS)
+    num_chunks = OBJ_MAX_CHUNKS;
+  if (num_chunks < 1)
+    num_chunks = 1;
+
+  obj_chunk_t chunks[OBJ_MAX_CHUNKS] = {0};
+  const char *end = data + size;
+  const char *begin = data;
+  for (int i = 0; i < num_chunks; i++)
+  {
+    const char *chunk_end = i == num_chunks - 1 ? end : data + size / num_chunks * (i + 1);
+    if (chunk_end < begin)
+    {
+      chunk_end = begin;
+    }
+    if (chunk_end < end && chunk_end > data && chunk_end[-1] != '\n')
+    {
+      chunk_end = skip_line(chunk_end, end);
+    }
+    chunks[i].begin = begin;
+    chunks[i].end = chunk_end;
+    begin = chunk_end;
+  }
+
+  // the calling thread parses the first chunk while the others run
+  for (int i = 1; i < num_chunks; i++)
+  {
+    chunks[i].thread = SDL_CreateThread(parse_chunk_thread, "obj parser", &chunks[i]);
+    if (chunks[i].thread == NULL)
+    {
+      parse_chunk(&chunks[i]);
+    }
+  }
+  parse_chunk(&chunks[0]);
+  for (int i = 1; i < num_chunks; i++)
+  {
+    SDL_WaitThread(chunks[i].thread, NULL);
+  }
+
+  // merge the chunks in file order
+  int num_vertices = 0;
+  int num_texcoords = 0;
+  for (int i = 0; i < num_chunks; i++)
+  {
+    num_vertices += array_length(chunks[i].vertices);
+    num_texcoords += array_length(chunks[i].texcoords);
+  }
+
+  tex2_t *texcoords = NULL;
+  int vertex_base = 0;
+  int texcoord_base = 0;
+  for (int i = 0; i < num_chunks; i++)
+  {
+    int chunk_vertices = array_length(chunks[i].vertices);
+    if (chunk_vertices > 0)
+    {
+      *vertices = array_hold(*vertices, chunk_vertices, sizeof(vec3_t));
+      memcpy(*vertices + array_length(*vertices) - chunk_vertices, chunks[i].vertices, sizeof(vec3_t) * chunk_vertices);
+    }
+    int chunk_texcoords = array_length(chunks[i].texcoords);
+    if (chunk_texcoords > 0)
+    {
+      texcoords = array_hold(texcoords, chunk_texcoords, sizeof(tex2_t));
+      memcpy(texcoords + array_length(texcoords) - chunk_texcoords, chunks[i].texcoords, sizeof(tex2_t) * chunk_texcoords);
+    }
+  }
+
+  int num_invalid_faces = 0;
+  for (int i = 0; i < num_chunks; i++)
+  {
+    for (int j = 0; j < array_length(chunks[i].faces); j++)
+    {
+      obj_face_t *obj_face = &chunks[i].faces[j];
+      int vertex[3];
+      tex2_t uv[3];
+      bool is_valid = obj_face->is_valid;
+      for (int k = 0; k < 3; k++)
+      {
+        vertex[k] = resolve_index(obj_face->vertex[k], obj_face->relative_mask & (1 << k), vertex_base, num_vertices);
+        is_valid = is_valid && vertex[k] >= 0;
+
+        // faces without texture coordinates sample the texture corner
+        uv[k] = (tex2_t){0, 0};
+        if (obj_face->texcoord[k] != OBJ_NO_TEXCOORD || obj_face->relative_mask & (1 << (k + 3)))
+        {
+          int texcoord = resolve_index(obj_face->texcoord[k], obj_face->relative_mask & (1 << (k + 3)), texcoord_base, num_texcoords);
+          is_valid = is_valid && texcoord >= 0;
+          if (texcoord >= 0)
+          {
+            uv[k] = texcoords[texcoord];
+          }
+        }
+      }
+      if (!is_valid)
+      {
+        num_invalid_faces++;
+        continue;
+      }
+
+      face_t face = {
+        .a = vertex[0],
+        .b = vertex[1],
+        .c = vertex[2],
+        .a_uv = uv[0],
+        .b_uv = uv[1],
+        .c_uv = uv[2],
+        .color = 0xFFFFFFFF,
+      };
+      array_push(*faces, face);
+    }
+    vertex_base += array_length(chunks[i].vertices);
+    texcoord_base += array_length(chunks[i].texcoords);
+  }
+
+  if (num_invalid_faces > 0)
+  {
+    fprintf(stderr, "Error: skipped %d OBJ faces referencing missing vertices or texture coordinates.\n", num_invalid_faces);
+  }
+
+  for (int i = 0; i < num_chunks; i++)
+  {
+    array_free(chunks[i].vertices);
+    array_free(chunks[i].texcoords);
+    array_free(chunks[i].faces);
+  }
+  array_free(texcoords);
+
+  return num_chunks;
+}
+
+void parse_obj_legacy(const char *data, size_t size, vec3_t **vertices, face_t **faces)
+{
+  tex2_t *texcoords = NULL;
+
+  char buff[512];
+  const char *line = data;
+  const char *end = data + size;
+  while (line < end)
+  {
+    // copy one line, cut to the buffer size like fgets() would
+    const char *newline = memchr(line, '\n', end - line);
+    size_t length = (newline != NULL ? newline : end) - line;
+    if (length > sizeof(buff) - 1)
+    {
+      length = sizeof(buff) - 1;
+    }
+    memcpy(buff, line, length);
+    buff[length] = '\0';
+    line = newline != NULL ? newline + 1 : end;
+
+    // vertex information
+    if (buff[0] == 'v' && buff[1] == ' ')
+    {
+      vec3_t vertex;
+      sscanf(buff, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
+      array_push(*vertices, vertex);
+      continue;
+    }
+
+    // texture coordinate information
+    if (strncmp(buff, "vt", 2) == 0)
+    {
+      tex2_t texcoord;
+      sscanf(buff, "vt %f %f", &texcoord.u, &texcoord.v);
+      array_push(texcoords, texcoord);
+      continue;
+    }
+
+    // face information
+    if (buff[0] == 'f' && buff[1] == ' ')
+    {
+      int vertex_indices[3];
+      int texture_indices[3];
+      int normal_indices[3];
+      sscanf(
+        buff,
+        "f %d/%d/%d %d/%d/%d %d/%d/%d",
+        &vertex_indices[0], &texture_indices[0], &normal_indices[0],
+        &vertex_indices[1], &texture_indices[1], &normal_indices[1],
+        &vertex_indices[2], &texture_indices[2], &normal_indices[2]
+      );
+
+      face_t face = {
+        .a = vertex_indices[0] - 1,
+        .b = vertex_indices[1] - 1,
+        .c = vertex_indices[2] - 1,
+        .a_uv = texcoords[texture_indices[0] - 1],
+        .b_uv = texcoords[texture_indices[1] - 1],
+        .c_uv = texcoords[texture_indices[2] - 1],
+        .color = 0xFFFFFFFF,
+      };
+      array_push(*faces, face);
+      continue;
+    }
+  }
+
+  array_free(texcoords);
+}
+
+// time reading and parsing OBJ files with the sscanf() parser against the
+// mapped chunked parser, and check both produce the same mesh
+void benchmark_obj_loaders(int num_paths, char *paths[])
+{
+  for (int i = 0; i < num_paths; i++)
+  {
+    double legacy_ns_min = INFINITY;
+    double parser_ns_min = INFINITY;
+    int num_chunks = 0;
+    vec3_t *legacy_vertices = NULL;
+    face_t *legacy_faces = NULL;
+    vec3_t *vertices = NULL;
+    face_t *faces = NULL;
+
+    for (int run = 0; run < OBJ_BENCHMARK_RUNS; run++)
+    {
+      array_free(legacy_vertices);
+      array_free(legacy_faces);
+      legacy_vertices = NULL;
+      legacy_faces = NULL;
+      uint64_t start = SDL_GetTicksNS();
+      size_t size;
+      unsigned char *bytes = read_file(paths[i], &size);
+      if (bytes == NULL)
+      {
+        break;
+      }
+      parse_obj_legacy((const char *)bytes, size, &legacy_vertices, &legacy_faces);
+      free(bytes);
+      legacy_ns_min = fmin(legacy_ns_min, SDL_GetTicksNS() - start);
+
+      array_free(vertices);
+      array_free(faces);
+      vertices = NULL;
+      faces = NULL;
+      start = SDL_GetTicksNS();
+      const unsigned char *mapped = map_file(paths[i], &size);
+      if (mapped == NULL)
+      {
+        break;
+      }
+      num_chunks = parse_obj((const char *)mapped, size, &vertices, &faces);
+      unmap_file(mapped, size);
+      parser_ns_min = fmin(parser_ns_min, SDL_GetTicksNS() - start);
+    }
+
+    bool is_same = array_length(vertices) == array_length(legacy_vertices) && array_length(faces) == array_length(legacy_faces) &&
+                   memcmp(vertices, legacy_vertices, sizeof(vec3_t) * array_length(vertices)) == 0 &&
+                   memcmp(faces, legacy_faces, sizeof(face_t) * array_length(faces)) == 0;
+    printf(
+      "%s: %d vertices, %d faces, sscanf parser %.3f ms, mapped parser %.3f ms in %d chunks (%.1fx), %s\n",
+      paths[i],
+      array_length(vertices),
+      array_length(faces),
+      legacy_ns_min / 1e6,
+      parser_ns_min / 1e6,
+      num_chunks,
+      legacy_ns_min / parser_ns_min,
+      is_same ? "identical meshes" : "meshes differ"
+    );
+
+    array_free(legacy_vertices);
+    array_free(legacy_faces);
+    array_free(vertices);
+    array_free(faces);
+  }
+}
@@ -0,0 +1,164 @@
+#include "occlusion.h"
+#include "array.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "vector.h"
+#include <math.h>
+#include <stdlib.h>
+
+static float *occlusion_buffer = NULL;
+static int buffer_width = 0;
+static int buffer_height = 0;
+static mat4_t occlusion_proj_matrix;
+
+// occluder triangles closer than this are skipped instead of clipped
+#define OCCLUDER_MIN_Z 0.1
+
+void init_occlusion_buffer(int window_width, int window_height, mat4_t proj_matrix)
+{
+  buffer_width = window_width / OCCLUSION_BUFFER_DIVISOR;
+  buffer_height = window_height / OCCLUSION_BUFFER_DIVISOR;
+  occlusion_buffer = (float *)malloc(sizeof(float) * buffer_width * buffer_height);
+  occlusion_proj_matrix = proj_matrix;
+  clear_occlusion_buffer();
+}
+
+void clear_occlusion_buffer(void)
+{
+  for (int i = 0; i < buffer_width * buffer_height; i++)
+  {
+    occlusion_buffer[i] = INFINITY;
+  }
+}
+
+// camera space to occlusion buffer pixels, same orientation as the color buffer
+static vec2_t project_to_buffer(vec3_t point)
+{
+  vec4_t projected = mat4_mul_vec4_project(occlusion_proj_matrix, vec4_from_vec3(point));
+  return vec2_new((projected.x * 0.5 + 0.5) * buffer_width, (-projected.y * 0.5 + 0.5) * buffer_height);
+}
+
+// edge function with the pixel corner furthest inside subtracted, so it is only
+// positive when the whole pixel is on the inner side of the edge
+static float conservative_edge(vec2_t a, vec2_t b, float x, float y)
+{
+  float dx = b.x - a.x;
+  float dy = b.y - a.y;
+  return (x - a.x) * dy - (y - a.y) * dx - 0.5 * (fabsf(dx) + fabsf(dy));
+}
+
+static void rasterize_occluder_triangle(vec3_t v0, vec3_t v1, vec3_t v2)
+{
+  if (v0.z < OCCLUDER_MIN_Z || v1.z < OCCLUDER_MIN_Z || v2.z < OCCLUDER_MIN_Z)
+  {
+    return;
+  }
+
+  // the whole triangle is written at its farthest depth, which never hides more than the triangle does
+  float depth = fmaxf(v0.z, fmaxf(v1.z, v2.z));
+
+  vec2_t a = project_to_buffer(v0);
+  vec2_t b = project_to_buffer(v1);
+  vec2_t c = project_to_buffer(v2);
+
+  // either winding covers, back faces are rejected before with the face planes
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  if (area == 0)
+  {
+    return;
+  }
+  if (area > 0)
+  {
+    vec2_t tmp = b;
+    b = c;
+    c = tmp;
+  }
+
+  int x_min = fmaxf(0, floorf(fminf(a.x, fminf(b.x, c.x))));
+  int x_max = fminf(buffer_width - 1, ceilf(fmaxf(a.x, fmaxf(b.x, c.x))));
+  int y_min = fmaxf(0, floorf(fminf(a.y, fminf(b.y, c.y))));
+  int y_max = fminf(buffer_height - 1, ceilf(fmaxf(a.y, fmaxf(b.y, c.y))));
+
+  for (int y = y_min; y <= y_max; y++)
+  {
+    for (int x = x_min; x <= x_max; x++)
+    {
+      float px = x + 0.5;
+      float py = y + 0.5;
+      if (conservative_edge(a, b, px, py) >= 0 && conservative_edge(b, c, px, py) >= 0 && conservative_edge(c, a, px, py) >= 0)
+      {
+        float *stored = &occlusion_buffer[y * buffer_width + x];
+        if (depth < *stored)
+          *stored = depth;
+      }
+    }
+  }
+}
+
+void rasterize_occluder(mesh_t *mesh, mat4_t world_view_matrix, vec3_t camera_model_position, bool is_backface_culled)
+{
+  // the full resolution level, coarser levels may cover pixels the mesh does not
+  face_t *faces = mesh->lods[0].faces;
+  face_plane_t *face_planes = mesh->lods[0].face_planes;
+  for (int i = 0; i < array_length(faces); i++)
+  {
+    if (is_backface_culled && vec3_dot(face_planes[i].normal, camera_model_position) < face_planes[i].distance)
+    {
+      continue;
+    }
+
+    vec3_t v0 = vec3_from_vec4(mat4_mul_vec4(world_view_matrix, vec4_from_vec3(mesh->vertices[faces[i].a])));
+    vec3_t v1 = vec3_from_vec4(mat4_mul_vec4(world_view_matrix, vec4_from_vec3(mesh->vertices[faces[i].b])));
+    vec3_t v2 = vec3_from_vec4(mat4_mul_vec4(world_view_matrix, vec4_from_vec3(mesh->vertices[faces[i].c])));
+    rasterize_occluder_triangle(v0, v1, v2);
+  }
+}
+
+bool is_sphere_occluded(vec3_t center, float radius)
+{
+  float nearest_z = center.z - radius;
+  if (nearest_z < OCCLUDER_MIN_Z)
+  {
+    return false;
+  }
+
+  // screen rectangle of the box around the sphere
+  float x_min = INFINITY, y_min = INFINITY, x_max = -INFINITY, y_max = -INFINITY;
+  for (int corner = 0; corner < 8; corner++)
+  {
+    vec3_t point = vec3_new(
+      center.x + (corner & 1 ? radius : -radius),
+      center.y + (corner & 2 ? radius : -radius),
+      center.z + (corner & 4 ? radius : -radius)
+    );
+    vec2_t projected = project_to_buffer(point);
+    x_min = fminf(x_min, projected.x);
+    x_max = fmaxf(x_max, projected.x);
+    y_min = fminf(y_min, projected.y);
+    y_max = fmaxf(y_max, projected.y);
+  }
+
+  // anything reaching outside of the buffer counts as visible
+  if (x_min < 0 || y_min < 0 || x_max >= buffer_width || y_max >= buffer_height)
+  {
+    return false;
+  }
+
+  for (int y = floorf(y_min); y <= (int)ceilf(y_max) && y < buffer_height; y++)
+  {
+    for (int x = floorf(x_min); x <= (int)ceilf(x_max) && x < buffer_width; x++)
+    {
+      if (occlusion_buffer[y * buffer_width + x] >= nearest_z)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void free_occlusion_buffer(void)
+{
+  free(occlusion_buffer);
+  occlusion_buffer = NULL;
+}
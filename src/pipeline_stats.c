@@ -0,0 +1,78 @@
+#include "pipeline_stats.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+pipeline_counters_t geometry_counters;
+pipeline_counters_t raster_counters;
+
+static pipeline_counters_t total_counters;
+static int num_frames_counted = 0;
+static SDL_AtomicInt is_log_enabled;
+
+static void add_counters(pipeline_counters_t *sum, const pipeline_counters_t *counters)
+{
+  sum->faces_in += counters->faces_in;
+  sum->faces_backface_culled += counters->faces_backface_culled;
+  sum->faces_rejected += counters->faces_rejected;
+  sum->faces_accepted += counters->faces_accepted;
+  sum->faces_clipped += counters->faces_clipped;
+  sum->triangles_emitted += counters->triangles_emitted;
+  sum->triangles_dropped += counters->triangles_dropped;
+  sum->pixels_tested += counters->pixels_tested;
+  sum->pixels_passed += counters->pixels_passed;
+  sum->texels_fetched += counters->texels_fetched;
+  sum->transform_ns += counters->transform_ns;
+  sum->cull_ns += counters->cull_ns;
+  sum->clip_ns += counters->clip_ns;
+  sum->raster_ns += counters->raster_ns;
+}
+
+void set_pipeline_log(bool is_enabled)
+{
+  SDL_SetAtomicInt(&is_log_enabled, is_enabled);
+}
+
+void end_geometry_counters(pipeline_counters_t *frame)
+{
+  *frame = geometry_counters;
+  geometry_counters = (pipeline_counters_t){0};
+}
+
+void end_raster_counters(pipeline_counters_t *frame)
+{
+  add_counters(frame, &raster_counters);
+  raster_counters = (pipeline_counters_t){0};
+  add_counters(&total_counters, frame);
+  num_frames_counted++;
+
+  if (!SDL_GetAtomicInt(&is_log_enabled))
+  {
+    return;
+  }
+  printf(
+    "frame %d: %llu faces in, %llu backface culled, %llu rejected, %llu accepted, %llu clipped, "
+    "%llu triangles emitted, %llu dropped, %llu pixels tested, %llu passed, %llu texels fetched, "
+    "transform %.3f ms, cull %.3f ms, clip %.3f ms, raster %.3f ms\n",
+    num_frames_counted,
+    (unsigned long long)frame->faces_in,
+    (unsigned long long)frame->faces_backface_culled,
+    (unsigned long long)frame->faces_rejected,
+    (unsigned long long)frame->faces_accepted,
+    (unsigned long long)frame->faces_clipped,
+    (unsigned long long)frame->triangles_emitted,
+    (unsigned long long)frame->triangles_dropped,
+    (unsigned long long)frame->pixels_tested,
+    (unsigned long long)frame->pixels_passed,
+    (unsigned long long)frame->texels_fetched,
+    frame->transform_ns / 1e6,
+    frame->cull_ns / 1e6,
+    frame->clip_ns / 1e6,
+    frame->raster_ns / 1e6
+  );
+}
+
+pipeline_counters_t get_pipeline_counters(int *num_frames)
+{
+  *num_frames = num_frames_counted;
+  return total_counters;
+}
@@ -0,0 +1,258 @@
+#include "raster_thread.h"
+#include "benchmark.h"
+#include "display.h"
+#include "pipeline_stats.h"
+#include "render_queue.h"
+#include "triangle.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+
+// spins before a waiting thread starts to sleep between checks
+#define RASTER_SPIN_COUNT 4096
+#define RASTER_SLEEP_NS 50000
+
+enum raster_frame_state
+{
+  RASTER_FRAME_FREE, // owned by the geometry stage
+  RASTER_FRAME_READY // owned by the raster thread until it sets it free again
+};
+
+typedef struct
+{
+  render_queue_t queue;
+  int render_method; // render method when the geometry stage built the frame
+  SDL_AtomicInt state;
+} raster_frame_t;
+
+static raster_frame_t frames[2];
+static int geometry_index = 0;
+static SDL_Thread *raster_thread = NULL;
+static SDL_AtomicInt is_stopping;
+static SDL_AtomicInt last_raster_us; // raster time of the last frame, for frame pacing
+
+// color buffer handover: the raster thread owns the back buffer, the present
+// side the front buffer, and the third one is swapped between them with the
+// newest complete frame, flagged fresh until it is taken for presenting
+#define COLOR_BUFFER_INDEX_MASK 3
+#define COLOR_BUFFER_FRESH 4
+static int back_color_buffer = 0;
+static SDL_AtomicInt newest_color_buffer;
+static int front_color_buffer = 2;
+
+// the raster thread only writes the raster fields, the geometry stage the rest
+static raster_thread_stats_t stats;
+
+// spin for a handover that is about to happen, then sleep so a long wait does
+// not keep a whole core busy
+static void wait_backoff(int *spins)
+{
+  if (*spins < RASTER_SPIN_COUNT)
+  {
+    (*spins)++;
+    SDL_CPUPauseInstruction();
+  }
+  else
+  {
+    SDL_DelayNS(RASTER_SLEEP_NS);
+  }
+}
+
+static void rasterize_frame(const raster_frame_t *frame)
+{
+  clear_color_buffer(0xFF000000);
+  clear_z_buffer();
+
+  draw_grid();
+
+  const render_queue_t *queue = &frame->queue;
+  int method = frame->render_method;
+  for (int i = 0; i < queue->num_commands; i++)
+  {
+    const render_command_t *command = &queue->commands[i];
+    const raster_vertex_t *vertices = command->vertices;
+
+    // draw filled triangle
+    if (should_render_filled_triangles(method))
+    {
+      draw_filled_triangle(command);
+    }
+
+    // draw textured triangle
+    if (should_render_textured_triangle(method))
+    {
+      draw_textured_triangle(command);
+    }
+
+    // draw wireframe
+    if (should_render_wireframe(method))
+    {
+      draw_triangle(
+        vertices[0].x,
+        vertices[0].y,
+        vertices[1].x,
+        vertices[1].y,
+        vertices[2].x,
+        vertices[2].y,
+        0xFFFFFFFF
+      );
+    }
+
+    // draw the vertex
+    if (should_render_wire_vertex(method))
+    {
+      draw_rect(vertices[0].x - 3, vertices[0].y - 3, 6, 6, 0xFFFF0000);
+      draw_rect(vertices[1].x - 3, vertices[1].y - 3, 6, 6, 0xFFFF0000);
+      draw_rect(vertices[2].x - 3, vertices[2].y - 3, 6, 6, 0xFFFF0000);
+    }
+  }
+}
+
+static int raster_thread_main(void *data)
+{
+  (void)data;
+
+  // frames are submitted alternately, so the queues are drawn in the same order
+  int index = 0;
+  while (true)
+  {
+    raster_frame_t *frame = &frames[index];
+
+    uint64_t wait_start = SDL_GetTicksNS();
+    int spins = 0;
+    while (SDL_GetAtomicInt(&frame->state) != RASTER_FRAME_READY)
+    {
+      if (SDL_GetAtomicInt(&is_stopping))
+      {
+        return 0;
+      }
+      wait_backoff(&spins);
+    }
+    uint64_t raster_start = SDL_GetTicksNS();
+    stats.raster_idle_ns_sum += raster_start - wait_start;
+
+    set_color_buffer_target(back_color_buffer);
+    rasterize_frame(frame);
+    uint64_t raster_ns = SDL_GetTicksNS() - raster_start;
+    stats.raster_ns_sum += raster_ns;
+    SDL_SetAtomicInt(&last_raster_us, raster_ns / 1000);
+    record_benchmark_sample(BENCHMARK_STAGE_RASTER, raster_ns);
+    frame->queue.counters.raster_ns = raster_ns;
+    end_raster_counters(&frame->queue.counters);
+
+    // the queue goes back to the geometry stage
+    SDL_SetAtomicInt(&frame->state, RASTER_FRAME_FREE);
+    index ^= 1;
+
+    // publish the finished frame and keep drawing into the one it replaces;
+    // a frame that was never taken for presenting is dropped
+    int previous = SDL_SetAtomicInt(&newest_color_buffer, back_color_buffer | COLOR_BUFFER_FRESH);
+    if (previous & COLOR_BUFFER_FRESH)
+    {
+      stats.num_frames_dropped++;
+    }
+    back_color_buffer = previous & COLOR_BUFFER_INDEX_MASK;
+  }
+}
+
+bool start_raster_thread(int queue_capacity)
+{
+  for (int i = 0; i < 2; i++)
+  {
+    render_queue_init(&frames[i].queue, queue_capacity);
+    frames[i].render_method = RENDER_TEXTURED;
+    SDL_SetAtomicInt(&frames[i].state, RASTER_FRAME_FREE);
+  }
+  geometry_index = 0;
+  SDL_SetAtomicInt(&is_stopping, 0);
+
+  back_color_buffer = 0;
+  SDL_SetAtomicInt(&newest_color_buffer, 1);
+  front_color_buffer = 2;
+
+  raster_thread = SDL_CreateThread(raster_thread_main, "raster", NULL);
+  if (raster_thread == NULL)
+  {
+    fprintf(stderr, "Error: SDL_CreateThread(): %s.\n", SDL_GetError());
+    return false;
+  }
+  return true;
+}
+
+static void wait_for_frame_free(raster_frame_t *frame)
+{
+  int spins = 0;
+  while (SDL_GetAtomicInt(&frame->state) != RASTER_FRAME_FREE)
+  {
+    wait_backoff(&spins);
+  }
+}
+
+render_queue_t *begin_geometry_frame(void)
+{
+  // the queue is free once the raster thread has moved on to the last submitted frame
+  uint64_t wait_start = SDL_GetTicksNS();
+  wait_for_frame_free(&frames[geometry_index]);
+  stats.wait_ns_sum += SDL_GetTicksNS() - wait_start;
+  return &frames[geometry_index].queue;
+}
+
+void submit_raster_frame(int render_method)
+{
+  raster_frame_t *frame = &frames[geometry_index];
+  frame->render_method = render_method;
+  if (frame->queue.high_water > stats.high_water)
+  {
+    stats.high_water = frame->queue.high_water;
+  }
+  if (frame->queue.arena.high_water > stats.arena_high_water)
+  {
+    stats.arena_high_water = frame->queue.arena.high_water;
+    stats.arena_capacity = frame->queue.arena.capacity;
+  }
+  stats.num_frames++;
+
+  // publishes the queue contents written before it to the raster thread
+  SDL_SetAtomicInt(&frame->state, RASTER_FRAME_READY);
+  geometry_index ^= 1;
+}
+
+double get_last_raster_ns(void)
+{
+  return SDL_GetAtomicInt(&last_raster_us) * 1000.0;
+}
+
+int acquire_newest_color_buffer(void)
+{
+  if (!(SDL_GetAtomicInt(&newest_color_buffer) & COLOR_BUFFER_FRESH))
+  {
+    return -1;
+  }
+
+  // the raster thread may publish an even newer frame in between, which is then taken instead
+  int previous = SDL_SetAtomicInt(&newest_color_buffer, front_color_buffer);
+  front_color_buffer = previous & COLOR_BUFFER_INDEX_MASK;
+  stats.num_frames_presented++;
+  return front_color_buffer;
+}
+
+raster_thread_stats_t get_raster_thread_stats(void)
+{
+  return stats;
+}
+
+void stop_raster_thread(void)
+{
+  if (raster_thread != NULL)
+  {
+    wait_for_frame_free(&frames[0]);
+    wait_for_frame_free(&frames[1]);
+    SDL_SetAtomicInt(&is_stopping, 1);
+    SDL_WaitThread(raster_thread, NULL);
+    raster_thread = NULL;
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    render_queue_free(&frames[i].queue);
+  }
+}
@@ -0,0 +1,75 @@
+#include "render_queue.h"
+#include "arena.h"
+#include "triangle.h"
+#include <stdio.h>
+
+void render_queue_init(render_queue_t *queue, int capacity)
+{
+  if (capacity < 1)
+  {
+    capacity = 1;
+  }
+  arena_init(&queue->arena, sizeof(render_command_t) * capacity);
+  queue->commands = NULL;
+  queue->num_commands = 0;
+  queue->capacity = capacity;
+  queue->high_water = 0;
+  render_queue_reset(queue);
+}
+
+void render_queue_reset(render_queue_t *queue)
+{
+  arena_reset(&queue->arena);
+
+  // reserve as many commands as the busiest frame so far, so a steady
+  // scene never has to grow the queue again
+  if (queue->high_water > queue->capacity)
+  {
+    queue->capacity = queue->high_water;
+  }
+  queue->commands = (render_command_t *)arena_alloc(&queue->arena, sizeof(render_command_t) * queue->capacity);
+  queue->num_commands = 0;
+
+  // without the reserve the first push tries to grow the queue, and reports
+  // the error when that fails too
+  if (queue->commands == NULL)
+  {
+    queue->capacity = 0;
+  }
+}
+
+render_command_t *render_queue_push(render_queue_t *queue)
+{
+  if (queue->num_commands == queue->capacity)
+  {
+    int capacity = queue->capacity > 0 ? queue->capacity * 2 : 1;
+    render_command_t *commands = (render_command_t *)arena_grow(
+      &queue->arena,
+      queue->commands,
+      sizeof(render_command_t) * queue->capacity,
+      sizeof(render_command_t) * capacity
+    );
+    if (commands == NULL)
+    {
+      fprintf(stderr, "Error: out of memory growing the render queue to %d commands.\n", capacity);
+      return NULL;
+    }
+    queue->commands = commands;
+    queue->capacity = capacity;
+  }
+
+  queue->num_commands++;
+  if (queue->num_commands > queue->high_water)
+  {
+    queue->high_water = queue->num_commands;
+  }
+  return &queue->commands[queue->num_commands - 1];
+}
+
+void render_queue_free(render_queue_t *queue)
+{
+  arena_free(&queue->arena);
+  queue->commands = NULL;
+  queue->num_commands = 0;
+  queue->capacity = 0;
+}
@@ -0,0 +1,426 @@
+#include "simplify.h"
+#include "array.h"
+#include "triangle.h"
+#include "vector.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// minimum cosine between a face normal before and after a collapse
+#define SIMPLIFY_MAX_NORMAL_CHANGE 0.2
+
+// weight of the planes keeping open boundaries in place, relative to face planes
+#define SIMPLIFY_BOUNDARY_WEIGHT 10.0
+
+// symmetric 4x4 error quadric stored as its upper triangle:
+// a2 ab ac ad b2 bc bd c2 cd d2 for the plane ax + by + cz + d = 0
+typedef struct
+{
+  double q[10];
+} quadric_t;
+
+typedef struct
+{
+  int from;
+  int to;
+  double cost;
+} collapse_t;
+
+typedef struct
+{
+  int a;
+  int b;
+  int face;
+} edge_t;
+
+static void quadric_add_plane(quadric_t *quadric, vec3_t normal, double d, double weight)
+{
+  double a = normal.x, b = normal.y, c = normal.z;
+  double plane[10] = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+  for (int i = 0; i < 10; i++)
+  {
+    quadric->q[i] += plane[i] * weight;
+  }
+}
+
+static void quadric_add(quadric_t *a, const quadric_t *b)
+{
+  for (int i = 0; i < 10; i++)
+  {
+    a->q[i] += b->q[i];
+  }
+}
+
+static double quadric_error(const quadric_t *a, const quadric_t *b, vec3_t v)
+{
+  double q[10];
+  for (int i = 0; i < 10; i++)
+  {
+    q[i] = a->q[i] + b->q[i];
+  }
+  double x = v.x, y = v.y, z = v.z;
+  return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+         q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+         q[7] * z * z + 2 * q[8] * z +
+         q[9];
+}
+
+static int face_corner(face_t *face, int corner)
+{
+  return corner == 0 ? face->a : (corner == 1 ? face->b : face->c);
+}
+
+static tex2_t *face_corner_uv(face_t *face, int corner)
+{
+  return corner == 0 ? &face->a_uv : (corner == 1 ? &face->b_uv : &face->c_uv);
+}
+
+static void set_face_corner(face_t *face, int corner, int vertex)
+{
+  if (corner == 0)
+    face->a = vertex;
+  else if (corner == 1)
+    face->b = vertex;
+  else
+    face->c = vertex;
+}
+
+static vec3_t face_cross(vec3_t *vertices, int a, int b, int c)
+{
+  return vec3_cross(vec3_sub(vertices[b], vertices[a]), vec3_sub(vertices[c], vertices[a]));
+}
+
+static int compare_edges(const void *a, const void *b)
+{
+  const edge_t *edge_a = (const edge_t *)a;
+  const edge_t *edge_b = (const edge_t *)b;
+  if (edge_a->a != edge_b->a)
+    return (edge_a->a > edge_b->a) - (edge_a->a < edge_b->a);
+  return (edge_a->b > edge_b->b) - (edge_a->b < edge_b->b);
+}
+
+static int compare_collapses(const void *a, const void *b)
+{
+  double cost_a = ((const collapse_t *)a)->cost;
+  double cost_b = ((const collapse_t *)b)->cost;
+  return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+// find the vertices on open boundaries (edges used by a single face) and keep
+// them close to the boundary with planes through each boundary edge that are
+// perpendicular to its face; edges is scratch space for num_faces * 3 edges
+static void add_boundary_constraints(vec3_t *vertices, face_t *faces, int num_faces, bool *boundary, quadric_t *quadrics, edge_t *edges)
+{
+  for (int i = 0; i < num_faces; i++)
+  {
+    for (int corner = 0; corner < 3; corner++)
+    {
+      int vertex = face_corner(&faces[i], corner);
+      int next = face_corner(&faces[i], (corner + 1) % 3);
+      edges[i * 3 + corner] = (edge_t){vertex < next ? vertex : next, vertex < next ? next : vertex, i};
+    }
+  }
+
+  qsort(edges, num_faces * 3, sizeof(edge_t), compare_edges);
+  for (int i = 0; i < num_faces * 3;)
+  {
+    int count = 1;
+    while (i + count < num_faces * 3 && compare_edges(&edges[i], &edges[i + count]) == 0)
+    {
+      count++;
+    }
+    if (count == 1)
+    {
+      face_t *face = &faces[edges[i].face];
+      vec3_t edge = vec3_sub(vertices[edges[i].b], vertices[edges[i].a]);
+      vec3_t normal = vec3_cross(edge, face_cross(vertices, face->a, face->b, face->c));
+      float length = vec3_length(edge);
+      if (vec3_length(normal) > 0)
+      {
+        vec3_normalize(&normal);
+        double d = -vec3_dot(normal, vertices[edges[i].a]);
+        quadric_add_plane(&quadrics[edges[i].a], normal, d, length * length * SIMPLIFY_BOUNDARY_WEIGHT);
+        quadric_add_plane(&quadrics[edges[i].b], normal, d, length * length * SIMPLIFY_BOUNDARY_WEIGHT);
+      }
+      boundary[edges[i].a] = true;
+      boundary[edges[i].b] = true;
+    }
+    i += count;
+  }
+}
+
+static bool has_corner(face_t *face, int vertex)
+{
+  return face->a == vertex || face->b == vertex || face->c == vertex;
+}
+
+static tex2_t corner_uv_of(face_t *face, int vertex)
+{
+  return vertex == face->a ? face->a_uv : (vertex == face->b ? face->b_uv : face->c_uv);
+}
+
+// a face keeping 'from' must take the UV of 'to' from the collapsed face on the
+// same side of any UV seam, i.e. the one where 'from' has the same UV; fails
+// when no such face exists or two of them disagree, as that would tear the seam
+static bool find_collapsed_uv(face_t *faces, bool *alive, int *adjacency, int num_adjacent, int from, int to, tex2_t from_uv, tex2_t *to_uv)
+{
+  bool found = false;
+  for (int i = 0; i < num_adjacent; i++)
+  {
+    face_t *face = &faces[adjacency[i]];
+    if (!alive[adjacency[i]] || !has_corner(face, to))
+      continue;
+
+    tex2_t uv = corner_uv_of(face, from);
+    if (uv.u != from_uv.u || uv.v != from_uv.v)
+      continue;
+
+    tex2_t collapsed_uv = corner_uv_of(face, to);
+    if (found && (collapsed_uv.u != to_uv->u || collapsed_uv.v != to_uv->v))
+      return false;
+
+    *to_uv = collapsed_uv;
+    found = true;
+  }
+  return found;
+}
+
+// try to move vertex 'from' onto vertex 'to'; returns the number of faces removed
+static int collapse_edge(vec3_t *vertices, face_t *faces, bool *alive, bool *boundary, int *adjacency, int num_adjacent, int from, int to)
+{
+  int num_removed = 0;
+  for (int i = 0; i < num_adjacent; i++)
+  {
+    if (alive[adjacency[i]] && has_corner(&faces[adjacency[i]], to))
+      num_removed++;
+  }
+  if (num_removed == 0)
+  {
+    return 0;
+  }
+
+  // boundary vertices may only slide along their own boundary edges
+  if (boundary[from] && num_removed != 1)
+  {
+    return 0;
+  }
+
+  // reject collapses that tear a UV seam, flip or degenerate any remaining face
+  for (int i = 0; i < num_adjacent; i++)
+  {
+    face_t face = faces[adjacency[i]];
+    if (!alive[adjacency[i]] || has_corner(&face, to))
+      continue;
+
+    tex2_t to_uv;
+    if (!find_collapsed_uv(faces, alive, adjacency, num_adjacent, from, to, corner_uv_of(&face, from), &to_uv))
+    {
+      return 0;
+    }
+
+    vec3_t before = face_cross(vertices, face.a, face.b, face.c);
+    for (int corner = 0; corner < 3; corner++)
+    {
+      if (face_corner(&face, corner) == from)
+        set_face_corner(&face, corner, to);
+    }
+    vec3_t after = face_cross(vertices, face.a, face.b, face.c);
+
+    float length_before = vec3_length(before);
+    float length_after = vec3_length(after);
+    if (length_after < 1e-12f || vec3_dot(before, after) < SIMPLIFY_MAX_NORMAL_CHANGE * length_before * length_after)
+    {
+      return 0;
+    }
+  }
+
+  // move the remaining faces first, the collapsed ones still provide the UVs
+  for (int i = 0; i < num_adjacent; i++)
+  {
+    face_t *face = &faces[adjacency[i]];
+    if (!alive[adjacency[i]] || has_corner(face, to))
+      continue;
+
+    tex2_t to_uv;
+    find_collapsed_uv(faces, alive, adjacency, num_adjacent, from, to, corner_uv_of(face, from), &to_uv);
+    for (int corner = 0; corner < 3; corner++)
+    {
+      if (face_corner(face, corner) == from)
+      {
+        set_face_corner(face, corner, to);
+        *face_corner_uv(face, corner) = to_uv;
+      }
+    }
+  }
+
+  for (int i = 0; i < num_adjacent; i++)
+  {
+    face_t *face = &faces[adjacency[i]];
+    if (alive[adjacency[i]] && has_corner(face, from) && has_corner(face, to))
+      alive[adjacency[i]] = false;
+  }
+
+  return num_removed;
+}
+
+face_t *simplify_faces(vec3_t *vertices, face_t *faces, int target_num_faces)
+{
+  int num_vertices = array_length(vertices);
+  int num_faces = array_length(faces);
+
+  face_t *work = (face_t *)malloc(sizeof(face_t) * num_faces);
+  bool *alive = (bool *)malloc(sizeof(bool) * num_faces);
+  bool *boundary = (bool *)calloc(num_vertices, sizeof(bool));
+  int *touched = (int *)calloc(num_vertices, sizeof(int));
+  quadric_t *quadrics = (quadric_t *)calloc(num_vertices, sizeof(quadric_t));
+  int *adjacency_offsets = (int *)malloc(sizeof(int) * (num_vertices + 1));
+  int *adjacency = (int *)malloc(sizeof(int) * num_faces * 3);
+  collapse_t *collapses = (collapse_t *)malloc(sizeof(collapse_t) * num_faces * 3);
+  edge_t *edges = (edge_t *)malloc(sizeof(edge_t) * num_faces * 3);
+  if (work == NULL || alive == NULL || boundary == NULL || touched == NULL || quadrics == NULL || adjacency_offsets == NULL ||
+      adjacency == NULL || collapses == NULL || edges == NULL)
+  {
+    free(edges);
+    free(collapses);
+    free(adjacency);
+    free(adjacency_offsets);
+    free(quadrics);
+    free(touched);
+    free(boundary);
+    free(alive);
+    free(work);
+    return NULL;
+  }
+
+  for (int i = 0; i < num_faces; i++)
+  {
+    work[i] = faces[i];
+    alive[i] = true;
+  }
+
+  // every vertex starts with the area weighted planes of the faces around it
+  for (int i = 0; i < num_faces; i++)
+  {
+    vec3_t normal = face_cross(vertices, work[i].a, work[i].b, work[i].c);
+    float area = vec3_length(normal) * 0.5;
+    if (area <= 0)
+      continue;
+    vec3_normalize(&normal);
+    double d = -vec3_dot(normal, vertices[work[i].a]);
+    for (int corner = 0; corner < 3; corner++)
+    {
+      quadric_add_plane(&quadrics[face_corner(&work[i], corner)], normal, d, area);
+    }
+  }
+  add_boundary_constraints(vertices, work, num_faces, boundary, quadrics, edges);
+  free(edges);
+
+  int num_alive = num_faces;
+  for (int pass = 1; num_alive > target_num_faces; pass++)
+  {
+    // vertex to face adjacency of the faces still alive
+    for (int i = 0; i <= num_vertices; i++)
+    {
+      adjacency_offsets[i] = 0;
+    }
+    for (int i = 0; i < num_faces; i++)
+    {
+      if (!alive[i])
+        continue;
+      for (int corner = 0; corner < 3; corner++)
+        adjacency_offsets[face_corner(&work[i], corner) + 1]++;
+    }
+    for (int i = 0; i < num_vertices; i++)
+    {
+      adjacency_offsets[i + 1] += adjacency_offsets[i];
+    }
+    int *fill = touched; // reused as insertion cursor, reset below
+    for (int i = 0; i < num_vertices; i++)
+    {
+      fill[i] = adjacency_offsets[i];
+    }
+    for (int i = 0; i < num_faces; i++)
+    {
+      if (!alive[i])
+        continue;
+      for (int corner = 0; corner < 3; corner++)
+        adjacency[fill[face_corner(&work[i], corner)]++] = i;
+    }
+    for (int i = 0; i < num_vertices; i++)
+    {
+      touched[i] = 0;
+    }
+
+    // cheapest direction of every edge
+    int num_collapses = 0;
+    for (int i = 0; i < num_faces; i++)
+    {
+      if (!alive[i])
+        continue;
+      for (int corner = 0; corner < 3; corner++)
+      {
+        int p = face_corner(&work[i], corner);
+        int q = face_corner(&work[i], (corner + 1) % 3);
+        double cost_pq = quadric_error(&quadrics[p], &quadrics[q], vertices[q]);
+        double cost_qp = quadric_error(&quadrics[p], &quadrics[q], vertices[p]);
+        collapses[num_collapses++] = cost_pq <= cost_qp ? (collapse_t){p, q, cost_pq} : (collapse_t){q, p, cost_qp};
+      }
+    }
+    qsort(collapses, num_collapses, sizeof(collapse_t), compare_collapses);
+
+    // apply independent collapses in order of increasing error
+    int num_alive_before = num_alive;
+    for (int i = 0; i < num_collapses && num_alive > target_num_faces; i++)
+    {
+      int from = collapses[i].from;
+      int to = collapses[i].to;
+      if (touched[from] == pass || touched[to] == pass)
+        continue;
+
+      int first = adjacency_offsets[from];
+      int num_adjacent = adjacency_offsets[from + 1] - first;
+      int num_removed = collapse_edge(vertices, work, alive, boundary, &adjacency[first], num_adjacent, from, to);
+      if (num_removed == 0)
+        continue;
+
+      num_alive -= num_removed;
+      quadric_add(&quadrics[to], &quadrics[from]);
+
+      // the adjacency of everything around 'from' is stale until the next pass
+      touched[from] = pass;
+      touched[to] = pass;
+      for (int j = 0; j < num_adjacent; j++)
+      {
+        face_t *face = &work[adjacency[first + j]];
+        touched[face->a] = pass;
+        touched[face->b] = pass;
+        touched[face->c] = pass;
+      }
+    }
+
+    if (num_alive == num_alive_before)
+    {
+      break; // nothing left that can be collapsed
+    }
+  }
+
+  face_t *result = NULL;
+  for (int i = 0; i < num_faces; i++)
+  {
+    if (alive[i])
+    {
+      array_push(result, work[i]);
+    }
+  }
+
+  free(collapses);
+  free(adjacency);
+  free(adjacency_offsets);
+  free(quadrics);
+  free(touched);
+  free(boundary);
+  free(alive);
+  free(work);
+
+  return result;
+}
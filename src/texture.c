@@ -1,7 +1,484 @@
 #include "texture.h"
+#include "array.h"
+#include "asset.h"
+#include "asset_loader.h"
+#include "cooked_texture.h"
+#include "texture_compression.h"
+#include "upng.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// largest side of the placeholder sampled while the texels stream back in
+#define TEXTURE_PLACEHOLDER_SIZE 16
+
+// texels coming back in for a texture; the texture is cleared when it is
+// freed first, so the decoded texels are dropped when they arrive
+struct texture_stream
+{
+  texture_t *texture;
+};
+
+static int texture_format = TEXTURE_FORMAT_RGBA32;
+static texture_load_stats_t load_stats;
+static texture_residency_stats_t residency_stats;
+
+static size_t texture_budget = 0;
+static uint64_t texture_frame = 0;
+static texture_t **textures = NULL;        // dynamic array of the loaded textures, NULL where one was freed
+static texture_stream_t **streams = NULL; // dynamic array of the streams in flight, NULL where one finished
+
+static size_t get_texture_level_bytes(const texture_level_t *level)
+{
+  if (level->blocks != NULL)
+  {
+    int blocks_per_column = (level->height + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE;
+    return (size_t)level->blocks_per_row * blocks_per_column * sizeof(uint64_t);
+  }
+  return (size_t)level->width * level->height * sizeof(uint32_t);
+}
+
+static void free_texture_level(texture_level_t *level)
+{
+  if (level->cooked_data != NULL)
+  {
+    unmap_file(level->cooked_data, level->cooked_size);
+  }
+  else if (level->png != NULL)
+  {
+    upng_free(level->png);
+  }
+  else
+  {
+    free(level->texels);
+  }
+  free(level->blocks);
+}
+
+// keep only the blocks, releasing the decoded texels or the file they were
+// mapped from; an encoding failure keeps the texels
+static void compress_texture_level(texture_level_t *level)
+{
+  uint64_t *blocks = encode_bc1_blocks(level->texels, level->width, level->height);
+  if (blocks == NULL)
+  {
+    return;
+  }
+
+  if (level->cooked_data != NULL)
+  {
+    unmap_file(level->cooked_data, level->cooked_size);
+    level->cooked_data = NULL;
+  }
+  else
+  {
+    upng_free(level->png);
+    level->png = NULL;
+  }
+  level->texels = NULL;
+  level->blocks = blocks;
+  level->blocks_per_row = (level->width + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE;
+}
+
+// every placeholder texel is the average of the texels it covers
+static bool build_placeholder(texture_level_t *placeholder, const texture_level_t *level)
+{
+  int width = level->width < TEXTURE_PLACEHOLDER_SIZE ? level->width : TEXTURE_PLACEHOLDER_SIZE;
+  int height = level->height < TEXTURE_PLACEHOLDER_SIZE ? level->height : TEXTURE_PLACEHOLDER_SIZE;
+  uint32_t *texels = (uint32_t *)malloc(sizeof(uint32_t) * width * height);
+  if (texels == NULL)
+  {
+    return false;
+  }
+
+  for (int y = 0; y < height; y++)
+  {
+    int y_start = y * level->height / height;
+    int y_end = (y + 1) * level->height / height;
+    for (int x = 0; x < width; x++)
+    {
+      int x_start = x * level->width / width;
+      int x_end = (x + 1) * level->width / width;
+      uint64_t sums[4] = {0, 0, 0, 0};
+      for (int source_y = y_start; source_y < y_end; source_y++)
+      {
+        for (int source_x = x_start; source_x < x_end; source_x++)
+        {
+          uint32_t texel = level->texels[source_y * level->width + source_x];
+          for (int channel = 0; channel < 4; channel++)
+          {
+            sums[channel] += (texel >> (channel * 8)) & 0xff;
+          }
+        }
+      }
+
+      uint64_t count = (uint64_t)(y_end - y_start) * (x_end - x_start);
+      uint32_t average = 0;
+      for (int channel = 0; channel < 4; channel++)
+      {
+        average |= (uint32_t)((sums[channel] + count / 2) / count) << (channel * 8);
+      }
+      texels[y * width + x] = average;
+    }
+  }
+
+  *placeholder = (texture_level_t){
+    .width = width,
+    .height = height,
+    .texels = texels,
+  };
+  return true;
+}
+
+static bool load_texture_level(texture_level_t *level, const char *path, const unsigned char *bytes, size_t size, uint64_t content_hash)
+{
+  // the texels decoded from these exact PNG bytes before are mapped as is
+  char cooked_path[1024];
+  bool has_cooked_path = get_cooked_texture_path(path, cooked_path, sizeof(cooked_path));
+  if (has_cooked_path && load_cooked_texture(level, cooked_path, content_hash))
+  {
+    return true;
+  }
+
+  upng_t *png_image = upng_new_from_bytes(bytes, size);
+  if (png_image == NULL)
+  {
+    return false;
+  }
+
+  upng_decode(png_image);
+  if (upng_get_error(png_image) != UPNG_EOK)
+  {
+    upng_free(png_image);
+    return false;
+  }
+
+  *level = (texture_level_t){
+    .width = upng_get_width(png_image),
+    .height = upng_get_height(png_image),
+    .texels = (uint32_t *)upng_get_buffer(png_image),
+    .png = png_image,
+  };
+
+  // only 32 bit texels are sampled right, other formats are not worth keeping
+  if (has_cooked_path && upng_get_format(png_image) == UPNG_RGBA8)
+  {
+    write_cooked_texture(cooked_path, level, content_hash);
+  }
+  return true;
+}
+
+static void *load_texture_asset(const char *path, const unsigned char *bytes, size_t size, uint64_t content_hash)
+{
+  texture_t *texture = (texture_t *)calloc(1, sizeof(texture_t));
+  texture_level_t *level = (texture_level_t *)calloc(1, sizeof(texture_level_t));
+  size_t path_length = strlen(path);
+  char *path_copy = (char *)malloc(path_length + 1);
+  if (texture == NULL || level == NULL || path_copy == NULL ||
+      !load_texture_level(level, path, bytes, size, content_hash))
+  {
+    free(texture);
+    free(level);
+    free(path_copy);
+    return NULL;
+  }
+
+  // the placeholder averages the texels before they are compressed
+  if (!build_placeholder(&texture->placeholder, level))
+  {
+    free_texture_level(level);
+    free(level);
+    free(texture);
+    free(path_copy);
+    return NULL;
+  }
+  if (texture_format == TEXTURE_FORMAT_BC1)
+  {
+    compress_texture_level(level);
+  }
+
+  memcpy(path_copy, path, path_length + 1);
+  texture->path = path_copy;
+  texture->resident = level;
+  return texture;
+}
+
+static void free_texture_asset(void *data)
+{
+  texture_t *texture = (texture_t *)data;
+
+  // textures decoded only to stream their texels back in were never managed
+  for (int i = 0; i < array_length(textures); i++)
+  {
+    if (textures[i] != texture)
+      continue;
+
+    textures[i] = NULL;
+    residency_stats.placeholder_bytes -= get_texture_level_bytes(&texture->placeholder);
+    if (texture->resident != NULL)
+    {
+      residency_stats.resident_bytes -= get_texture_level_bytes(texture->resident);
+    }
+    break;
+  }
+  if (texture->stream != NULL)
+  {
+    texture->stream->texture = NULL;
+  }
+
+  if (texture->resident != NULL)
+  {
+    free_texture_level(texture->resident);
+    free(texture->resident);
+  }
+  free_texture_level(&texture->placeholder);
+  free(texture->path);
+  free(texture);
+}
+
+static void add_resident_bytes(size_t bytes)
+{
+  residency_stats.resident_bytes += bytes;
+  if (residency_stats.resident_bytes > residency_stats.peak_resident_bytes)
+  {
+    residency_stats.peak_resident_bytes = residency_stats.resident_bytes;
+  }
+}
+
+// runs on the thread owning the registry, also for textures decoded on other threads
+static void record_texture_load(void *data, uint64_t load_ns)
+{
+  texture_t *texture = (texture_t *)data;
+  texture_level_t *level = texture->resident;
+  if (level->is_cooked)
+  {
+    load_stats.num_cooked++;
+  }
+  else
+  {
+    load_stats.num_decoded++;
+  }
+  load_stats.load_ns_sum += load_ns;
+  load_stats.decoded_texel_bytes_sum += (double)level->width * level->height * sizeof(uint32_t);
+  load_stats.texel_bytes_sum += get_texture_level_bytes(level);
+  if (level->blocks != NULL)
+  {
+    load_stats.num_compressed++;
+  }
+
+  // managed from now on, as if drawn this frame so it is not evicted before it ever is
+  int slot = 0;
+  while (slot < array_length(textures) && textures[slot] != NULL)
+  {
+    slot++;
+  }
+  if (slot == array_length(textures))
+  {
+    array_push(textures, texture);
+  }
+  else
+  {
+    textures[slot] = texture;
+  }
+  texture->last_used_frame = texture_frame;
+  residency_stats.placeholder_bytes += get_texture_level_bytes(&texture->placeholder);
+  add_resident_bytes(get_texture_level_bytes(level));
+}
+
+static asset_registry_t texture_registry = {
+  .load = load_texture_asset,
+  .free = free_texture_asset,
+  .loaded = record_texture_load,
+};
+
+// takes the texels of the texture decoded again, which is freed right after
+static void on_texture_streamed(void *data, void *user_data)
+{
+  texture_stream_t *stream = (texture_stream_t *)user_data;
+  texture_t *loaded = (texture_t *)data;
+  for (int i = 0; i < array_length(streams); i++)
+  {
+    if (streams[i] == stream)
+    {
+      streams[i] = NULL;
+    }
+  }
+
+  texture_t *texture = stream->texture;
+  free(stream);
+  if (texture == NULL)
+  {
+    if (loaded != NULL)
+    {
+      free_texture_asset(loaded);
+    }
+    return;
+  }
+
+  texture->stream = NULL;
+  if (loaded == NULL)
+  {
+    fprintf(stderr, "Error: could not stream %s back in, drawing its placeholder.\n", texture->path);
+    texture->is_unavailable = true;
+    return;
+  }
+
+  texture->resident = loaded->resident;
+  loaded->resident = NULL;
+  free_texture_asset(loaded);
+  residency_stats.num_streamed_in++;
+  add_resident_bytes(get_texture_level_bytes(texture->resident));
+}
+
+static void stream_texture(texture_t *texture)
+{
+  texture_stream_t *stream = (texture_stream_t *)malloc(sizeof(texture_stream_t));
+  if (stream == NULL)
+  {
+    return;
+  }
+  stream->texture = texture;
+  texture->stream = stream;
+
+  int slot = 0;
+  while (slot < array_length(streams) && streams[slot] != NULL)
+  {
+    slot++;
+  }
+  if (slot == array_length(streams))
+  {
+    array_push(streams, stream);
+  }
+  else
+  {
+    streams[slot] = stream;
+  }
+
+  // without loader workers the callback runs before this returns
+  decode_asset_async(&texture_registry, texture->path, on_texture_streamed, stream);
+}
 
 tex2_t tex2_clone(tex2_t *t)
 {
   tex2_t result = {t->u, t->v};
   return result;
 }
+
+void set_texture_format(int format)
+{
+  texture_format = format;
+}
+
+void set_texture_budget(size_t budget_bytes)
+{
+  texture_budget = budget_bytes;
+  residency_stats.budget_bytes = budget_bytes;
+}
+
+texture_t *load_texture(char *png_filename)
+{
+  return (texture_t *)asset_acquire(&texture_registry, png_filename);
+}
+
+void load_texture_async(char *png_filename, asset_ready_t on_ready, void *user_data)
+{
+  load_asset_async(&texture_registry, png_filename, on_ready, user_data);
+}
+
+void release_texture(texture_t *texture)
+{
+  asset_release(&texture_registry, texture);
+}
+
+void update_texture_residency(void)
+{
+  texture_frame++;
+  if (texture_budget == 0)
+  {
+    return;
+  }
+
+  // the raster thread may still draw from the textures used in the last frame
+  while (residency_stats.resident_bytes > texture_budget)
+  {
+    texture_t *oldest = NULL;
+    for (int i = 0; i < array_length(textures); i++)
+    {
+      texture_t *texture = textures[i];
+      if (texture == NULL || texture->resident == NULL || texture->last_used_frame + 2 > texture_frame)
+        continue;
+
+      if (oldest == NULL || texture->last_used_frame < oldest->last_used_frame)
+      {
+        oldest = texture;
+      }
+    }
+    if (oldest == NULL)
+    {
+      break;
+    }
+
+    residency_stats.resident_bytes -= get_texture_level_bytes(oldest->resident);
+    residency_stats.num_evicted++;
+    free_texture_level(oldest->resident);
+    free(oldest->resident);
+    oldest->resident = NULL;
+  }
+}
+
+const texture_level_t *use_texture(texture_t *texture)
+{
+  if (texture == NULL)
+  {
+    return NULL;
+  }
+
+  texture->last_used_frame = texture_frame;
+  residency_stats.num_uses++;
+  if (texture->resident != NULL)
+  {
+    return texture->resident;
+  }
+
+  if (texture->stream == NULL && !texture->is_unavailable)
+  {
+    stream_texture(texture);
+  }
+  if (texture->resident != NULL)
+  {
+    return texture->resident;
+  }
+  residency_stats.num_placeholder_uses++;
+  return &texture->placeholder;
+}
+
+int get_num_textures(void)
+{
+  return asset_count(&texture_registry);
+}
+
+texture_load_stats_t get_texture_load_stats(void)
+{
+  return load_stats;
+}
+
+texture_residency_stats_t get_texture_residency_stats(void)
+{
+  return residency_stats;
+}
+
+void free_textures(void)
+{
+  asset_registry_free(&texture_registry);
+  array_free(textures);
+  textures = NULL;
+
+  // streams still in flight lost their callbacks when the loader stopped
+  for (int i = 0; i < array_length(streams); i++)
+  {
+    free(streams[i]);
+  }
+  array_free(streams);
+  streams = NULL;
+}
@@ -0,0 +1,414 @@
+#include "texture_compression.h"
+#include "asset.h"
+#include "texture.h"
+#include "upng.h"
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BC1_TEXELS_PER_BLOCK (BC1_BLOCK_SIZE * BC1_BLOCK_SIZE)
+
+// texels with less alpha are encoded as transparent black
+#define BC1_ALPHA_THRESHOLD 128
+
+// runs of the encoder and of each sampling pattern, and texels fetched per
+// run, when timing texture formats
+#define TEXTURE_BENCHMARK_RUNS 5
+#define TEXTURE_BENCHMARK_FETCHES (1 << 22)
+
+static const char *format_names[] = {"rgba32", "bc1"};
+
+bool parse_texture_format(const char *name, int *format)
+{
+  for (int i = 0; i < (int)(sizeof(format_names) / sizeof(format_names[0])); i++)
+  {
+    if (strcmp(name, format_names[i]) == 0)
+    {
+      *format = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// channel i of a texel is its byte i, the 565 color keeps the first channel
+// in the top bits and the third in the bottom bits
+static int get_channel(uint32_t texel, int channel)
+{
+  return (texel >> (channel * 8)) & 0xff;
+}
+
+static uint32_t pack_565(const float color[3])
+{
+  int c0 = (int)(fminf(fmaxf(color[0], 0), 255) * 31 / 255 + 0.5f);
+  int c1 = (int)(fminf(fmaxf(color[1], 0), 255) * 63 / 255 + 0.5f);
+  int c2 = (int)(fminf(fmaxf(color[2], 0), 255) * 31 / 255 + 0.5f);
+  return (c0 << 11) | (c1 << 5) | c2;
+}
+
+// palette colors as weights of the two end colors, scaled by a reciprocal
+// of 3 or 2 and shifted down by BC1_WEIGHT_SHIFT, with the alpha they get;
+// the first four are the three color palette, the last four the four color one
+#define BC1_WEIGHT_SHIFT 11
+
+typedef struct
+{
+  uint32_t weight0;
+  uint32_t weight1;
+  uint32_t reciprocal; // 2048 / 3 rounded up is exact for sums up to 3 * 255
+  uint32_t alpha;
+} bc1_palette_weights_t;
+
+static const bc1_palette_weights_t palette_weights[8] = {
+  {2, 0, 1024, 0xff000000u},
+  {0, 2, 1024, 0xff000000u},
+  {1, 1, 1024, 0xff000000u},
+  {0, 0, 1024, 0},
+  {3, 0, 683, 0xff000000u},
+  {0, 3, 683, 0xff000000u},
+  {2, 1, 683, 0xff000000u},
+  {1, 2, 683, 0xff000000u},
+};
+
+// the three channels of an expanded 565 color 21 bits apart, so a weighted
+// sum of two colors scaled by the reciprocal never carries into the next one
+static uint64_t spread_565(uint64_t color)
+{
+  uint64_t c0 = (color >> 11) & 0x1f;
+  uint64_t c1 = (color >> 5) & 0x3f;
+  uint64_t c2 = color & 0x1f;
+  return ((c0 << 3) | (c0 >> 2)) | (((c1 << 2) | (c1 >> 4)) << 21) | (((c2 << 3) | (c2 >> 2)) << 42);
+}
+
+// the four colors a block's indices select, computed the same way for every
+// index so the decoder does not branch on it
+static void get_bc1_palette(uint32_t color0, uint32_t color1, uint32_t palette[4])
+{
+  const bc1_palette_weights_t *weights = &palette_weights[(color0 > color1) * 4];
+  uint64_t end0 = spread_565(color0);
+  uint64_t end1 = spread_565(color1);
+  for (int i = 0; i < 4; i++)
+  {
+    uint64_t sum = (end0 * weights[i].weight0 + end1 * weights[i].weight1) * weights[i].reciprocal;
+    uint32_t color = ((sum >> BC1_WEIGHT_SHIFT) & 0xff) | ((sum >> (21 + BC1_WEIGHT_SHIFT - 8)) & 0xff00) |
+                     ((sum >> (42 + BC1_WEIGHT_SHIFT - 16)) & 0xff0000);
+    palette[i] = (color | weights[i].alpha) & -(uint32_t)(weights[i].alpha != 0);
+  }
+}
+
+uint32_t decode_bc1_texel(bc1_block_cache_t *cache, const uint64_t *blocks, int blocks_per_row, int x, int y)
+{
+  // coordinates are never negative, unsigned division by the block size is a shift
+  int block = ((unsigned)y / BC1_BLOCK_SIZE) * blocks_per_row + (unsigned)x / BC1_BLOCK_SIZE;
+  if (block != cache->block)
+  {
+    uint64_t bits = blocks[block];
+    get_bc1_palette(bits & 0xffff, (bits >> 16) & 0xffff, cache->palette);
+    cache->indices = bits >> 32;
+    cache->block = block;
+  }
+
+  unsigned texel = ((unsigned)y % BC1_BLOCK_SIZE) * BC1_BLOCK_SIZE + (unsigned)x % BC1_BLOCK_SIZE;
+  return cache->palette[(cache->indices >> (texel * 2)) & 3];
+}
+
+// end colors at the extremes of the texels along their principal axis, then
+// every texel gets the closest palette color
+static uint64_t encode_bc1_block(const uint32_t texels[BC1_TEXELS_PER_BLOCK])
+{
+  float mean[3] = {0, 0, 0};
+  int num_opaque = 0;
+  for (int i = 0; i < BC1_TEXELS_PER_BLOCK; i++)
+  {
+    if (get_channel(texels[i], 3) < BC1_ALPHA_THRESHOLD)
+      continue;
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+      mean[channel] += get_channel(texels[i], channel);
+    }
+    num_opaque++;
+  }
+
+  // equal end colors select the three color palette, index 3 is transparent
+  if (num_opaque == 0)
+  {
+    return 0xffffffffULL << 32;
+  }
+
+  float covariance[3][3] = {{0}};
+  for (int channel = 0; channel < 3; channel++)
+  {
+    mean[channel] /= num_opaque;
+  }
+  for (int i = 0; i < BC1_TEXELS_PER_BLOCK; i++)
+  {
+    if (get_channel(texels[i], 3) < BC1_ALPHA_THRESHOLD)
+      continue;
+
+    float d[3];
+    for (int channel = 0; channel < 3; channel++)
+    {
+      d[channel] = get_channel(texels[i], channel) - mean[channel];
+    }
+    for (int row = 0; row < 3; row++)
+    {
+      for (int column = 0; column < 3; column++)
+      {
+        covariance[row][column] += d[row] * d[column];
+      }
+    }
+  }
+
+  // power iteration converges on the axis the colors spread the most along
+  float axis[3] = {1, 1, 1};
+  for (int iteration = 0; iteration < 8; iteration++)
+  {
+    float next[3];
+    for (int row = 0; row < 3; row++)
+    {
+      next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+    }
+    float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f)
+      break;
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+      axis[channel] = next[channel] / length;
+    }
+  }
+
+  float min_projection = INFINITY;
+  float max_projection = -INFINITY;
+  for (int i = 0; i < BC1_TEXELS_PER_BLOCK; i++)
+  {
+    if (get_channel(texels[i], 3) < BC1_ALPHA_THRESHOLD)
+      continue;
+
+    float projection = 0;
+    for (int channel = 0; channel < 3; channel++)
+    {
+      projection += (get_channel(texels[i], channel) - mean[channel]) * axis[channel];
+    }
+    min_projection = fminf(min_projection, projection);
+    max_projection = fmaxf(max_projection, projection);
+  }
+
+  float max_end[3];
+  float min_end[3];
+  for (int channel = 0; channel < 3; channel++)
+  {
+    max_end[channel] = mean[channel] + axis[channel] * max_projection;
+    min_end[channel] = mean[channel] + axis[channel] * min_projection;
+  }
+  uint32_t color0 = pack_565(max_end);
+  uint32_t color1 = pack_565(min_end);
+
+  // the four color palette needs color0 > color1 and has no transparency
+  bool has_transparent = num_opaque < BC1_TEXELS_PER_BLOCK;
+  if (has_transparent ? color0 > color1 : color0 < color1)
+  {
+    uint32_t swap = color0;
+    color0 = color1;
+    color1 = swap;
+  }
+  int num_colors = color0 > color1 ? 4 : 3;
+
+  uint32_t palette[4];
+  get_bc1_palette(color0, color1, palette);
+
+  uint64_t indices = 0;
+  for (int i = 0; i < BC1_TEXELS_PER_BLOCK; i++)
+  {
+    int best_index = 3;
+    if (get_channel(texels[i], 3) >= BC1_ALPHA_THRESHOLD)
+    {
+      int best_error = INT32_MAX;
+      for (int j = 0; j < num_colors; j++)
+      {
+        int error = 0;
+        for (int channel = 0; channel < 3; channel++)
+        {
+          int d = get_channel(texels[i], channel) - get_channel(palette[j], channel);
+          error += d * d;
+        }
+        if (error < best_error)
+        {
+          best_error = error;
+          best_index = j;
+        }
+      }
+    }
+    indices |= (uint64_t)best_index << (i * 2);
+  }
+
+  return color0 | ((uint64_t)color1 << 16) | (indices << 32);
+}
+
+uint64_t *encode_bc1_blocks(const uint32_t *texels, int width, int height)
+{
+  int blocks_per_row = (width + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE;
+  int blocks_per_column = (height + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE;
+  uint64_t *blocks = (uint64_t *)malloc(sizeof(uint64_t) * blocks_per_row * blocks_per_column);
+  if (blocks == NULL)
+  {
+    return NULL;
+  }
+
+  for (int block_y = 0; block_y < blocks_per_column; block_y++)
+  {
+    for (int block_x = 0; block_x < blocks_per_row; block_x++)
+    {
+      uint32_t block_texels[BC1_TEXELS_PER_BLOCK];
+      for (int i = 0; i < BC1_TEXELS_PER_BLOCK; i++)
+      {
+        int x = block_x * BC1_BLOCK_SIZE + i % BC1_BLOCK_SIZE;
+        int y = block_y * BC1_BLOCK_SIZE + i / BC1_BLOCK_SIZE;
+        block_texels[i] = texels[(y < height ? y : height - 1) * width + (x < width ? x : width - 1)];
+      }
+      blocks[block_y * blocks_per_row + block_x] = encode_bc1_block(block_texels);
+    }
+  }
+  return blocks;
+}
+
+// fetch texels along the rows, as a triangle close to the camera samples
+// them, or scattered over the texture, as small and rotated triangles do;
+// the sum keeps the fetches from being optimized away
+static uint32_t fetch_benchmark_texels(texture_level_t *texture, bool is_scattered)
+{
+  bc1_block_cache_t block_cache = {.block = -1};
+  uint32_t sum = 0;
+  uint32_t random = 1;
+  int x = 0;
+  int y = 0;
+  for (int i = 0; i < TEXTURE_BENCHMARK_FETCHES; i++)
+  {
+    if (is_scattered)
+    {
+      random = random * 1664525 + 1013904223;
+      x = ((random >> 16) * texture->width) >> 16;
+      y = ((random & 0xffff) * texture->height) >> 16;
+    }
+    else if (++x == texture->width)
+    {
+      x = 0;
+      y = y + 1 < texture->height ? y + 1 : 0;
+    }
+    sum += texture->blocks != NULL ? decode_bc1_texel(&block_cache, texture->blocks, texture->blocks_per_row, x, y)
+                                   : texture->texels[y * texture->width + x];
+  }
+  return sum;
+}
+
+static double time_benchmark_fetches(texture_level_t *texture, bool is_scattered, uint32_t *checksum)
+{
+  double fetch_ns_min = INFINITY;
+  for (int run = 0; run < TEXTURE_BENCHMARK_RUNS; run++)
+  {
+    uint64_t start = SDL_GetTicksNS();
+    *checksum += fetch_benchmark_texels(texture, is_scattered);
+    fetch_ns_min = fmin(fetch_ns_min, SDL_GetTicksNS() - start);
+  }
+  return fetch_ns_min / TEXTURE_BENCHMARK_FETCHES;
+}
+
+void benchmark_texture_formats(int num_paths, char *paths[])
+{
+  uint32_t checksum = 0;
+  for (int i = 0; i < num_paths; i++)
+  {
+    size_t size;
+    unsigned char *bytes = read_file(paths[i], &size);
+    if (bytes == NULL)
+    {
+      continue;
+    }
+
+    upng_t *png = upng_new_from_bytes(bytes, size);
+    if (png == NULL || upng_decode(png) != UPNG_EOK || upng_get_format(png) != UPNG_RGBA8)
+    {
+      fprintf(stderr, "Error: %s is not an RGBA PNG file.\n", paths[i]);
+      upng_free(png);
+      free(bytes);
+      continue;
+    }
+
+    texture_level_t texture = {
+      .width = upng_get_width(png),
+      .height = upng_get_height(png),
+      .texels = (uint32_t *)upng_get_buffer(png),
+    };
+    texture_level_t compressed = {
+      .width = texture.width,
+      .height = texture.height,
+      .blocks_per_row = (texture.width + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE,
+    };
+
+    double encode_ns_min = INFINITY;
+    for (int run = 0; run < TEXTURE_BENCHMARK_RUNS; run++)
+    {
+      free(compressed.blocks);
+      uint64_t start = SDL_GetTicksNS();
+      compressed.blocks = encode_bc1_blocks(texture.texels, texture.width, texture.height);
+      encode_ns_min = fmin(encode_ns_min, SDL_GetTicksNS() - start);
+    }
+    if (compressed.blocks == NULL)
+    {
+      fprintf(stderr, "Error: out of memory compressing %s.\n", paths[i]);
+      upng_free(png);
+      free(bytes);
+      continue;
+    }
+
+    // color error of the opaque texels, transparent ones all become black
+    bc1_block_cache_t block_cache = {.block = -1};
+    double squared_error_sum = 0;
+    int num_opaque = 0;
+    for (int y = 0; y < texture.height; y++)
+    {
+      for (int x = 0; x < texture.width; x++)
+      {
+        uint32_t original = texture.texels[y * texture.width + x];
+        uint32_t decoded = decode_bc1_texel(&block_cache, compressed.blocks, compressed.blocks_per_row, x, y);
+        if (decoded >> 24 == 0)
+          continue;
+
+        for (int channel = 0; channel < 3; channel++)
+        {
+          double d = (double)((original >> (channel * 8)) & 0xff) - ((decoded >> (channel * 8)) & 0xff);
+          squared_error_sum += d * d;
+        }
+        num_opaque++;
+      }
+    }
+    double mean_squared_error = num_opaque > 0 ? squared_error_sum / (num_opaque * 3.0) : 0;
+
+    int blocks_per_column = (texture.height + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE;
+    printf(
+      "%s: %dx%d, %.1f KiB decoded and %.1f KiB as BC1, encoded in %.3f ms with %.2f dB PSNR, "
+      "row fetches %.2f ns decoded and %.2f ns BC1, scattered fetches %.2f ns decoded and %.2f ns BC1\n",
+      paths[i],
+      texture.width,
+      texture.height,
+      texture.width * texture.height * sizeof(uint32_t) / 1024.0,
+      compressed.blocks_per_row * blocks_per_column * sizeof(uint64_t) / 1024.0,
+      encode_ns_min / 1e6,
+      mean_squared_error > 0 ? 10 * log10(255.0 * 255.0 / mean_squared_error) : INFINITY,
+      time_benchmark_fetches(&texture, false, &checksum),
+      time_benchmark_fetches(&compressed, false, &checksum),
+      time_benchmark_fetches(&texture, true, &checksum),
+      time_benchmark_fetches(&compressed, true, &checksum)
+    );
+
+    free(compressed.blocks);
+    upng_free(png);
+    free(bytes);
+  }
+
+  // printed so the fetches have a visible result
+  printf("checksum %08x\n", checksum);
+}
@@ -1,12 +1,23 @@
 #include "triangle.h"
 #include "display.h"
+#include "pipeline_stats.h"
 #include "swap.h"
 #include "texture.h"
-#include "upng.h"
 #include "vector.h"
 #include <stdint.h>
 #include <stdlib.h>
 
+// scissor a scanline range against the color buffer, so triangles reaching
+// into the clipping guard band never walk pixels outside of the screen
+static int clamp_int(int value, int min, int max)
+{
+  if (value < min)
+    return min;
+  if (value > max)
+    return max;
+  return value;
+}
+
 vec3_t get_triangle_normal(vec4_t vertices[3])
 {
   // calculate vectors from triangle vertices
@@ -52,61 +63,63 @@ vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p)
 
 void draw_triangle_pixel(
   int x, int y, uint32_t color,
-  vec4_t point_a, vec4_t point_b, vec4_t point_c
+  const raster_vertex_t *a, const raster_vertex_t *b, const raster_vertex_t *c
 )
 {
   vec2_t point_p = {x, y};
-  vec3_t weights = barycentric_weights(vec2_from_vec4(point_a), vec2_from_vec4(point_b), vec2_from_vec4(point_c), point_p);
+  vec3_t weights = barycentric_weights(vec2_new(a->x, a->y), vec2_new(b->x, b->y), vec2_new(c->x, c->y), point_p);
 
   float alpha = weights.x;
   float beta = weights.y;
   float gamma = weights.z;
 
-  float interpolated_reciprocal_w = (1 / point_a.w * alpha) + (1 / point_b.w * beta) + (1 / point_c.w * gamma);
+  float interpolated_reciprocal_w = (a->inv_w * alpha) + (b->inv_w * beta) + (c->inv_w * gamma);
 
   interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
 
+  count_raster(pixels_tested, 1);
   if (interpolated_reciprocal_w < get_zbuffer_at(x, y))
   {
+    count_raster(pixels_passed, 1);
     draw_pixel(x, y, color);
     set_zbuffer_at(x, y, interpolated_reciprocal_w);
   }
 }
 
-void draw_filled_triangle(
-  int x0, int y0, float z0, float w0, // Vertex A
-  int x1, int y1, float z1, float w1, // Vertex B
-  int x2, int y2, float z2, float w2, // Vertex C
-  uint32_t color
+static void raster_vertex_swap(const raster_vertex_t **a, const raster_vertex_t **b)
+{
+  const raster_vertex_t *tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+// sort the vertices of a command by y-coordinate (a.y <= b.y <= c.y) without copying them
+static void sort_raster_vertices(
+  const render_command_t *command,
+  const raster_vertex_t **a, const raster_vertex_t **b, const raster_vertex_t **c
 )
 {
-  // sort vertices by y-coordinate (y0 < y1 < y3)
-  if (y0 > y1)
-  {
-    int_swap(&y0, &y1);
-    int_swap(&x0, &x1);
-    float_swap(&z0, &z1);
-    float_swap(&w0, &w1);
-  }
-  if (y1 > y2)
-  {
-    int_swap(&y1, &y2);
-    int_swap(&x1, &x2);
-    float_swap(&z1, &z2);
-    float_swap(&w1, &w2);
-  }
-  if (y0 > y1)
-  {
-    int_swap(&y0, &y1);
-    int_swap(&x0, &x1);
-    float_swap(&z0, &z1);
-    float_swap(&w0, &w1);
-  }
+  *a = &command->vertices[0];
+  *b = &command->vertices[1];
+  *c = &command->vertices[2];
+
+  if ((*a)->y > (*b)->y)
+    raster_vertex_swap(a, b);
+  if ((*b)->y > (*c)->y)
+    raster_vertex_swap(b, c);
+  if ((*a)->y > (*b)->y)
+    raster_vertex_swap(a, b);
+}
 
-  // vector points
-  vec4_t point_a = {x0, y0, z0, w0};
-  vec4_t point_b = {x1, y1, z1, w1};
-  vec4_t point_c = {x2, y2, z2, w2};
+void draw_filled_triangle(const render_command_t *command)
+{
+  const raster_vertex_t *a, *b, *c;
+  sort_raster_vertices(command, &a, &b, &c);
+
+  int x0 = a->x, y0 = a->y;
+  int x1 = b->x, y1 = b->y;
+  int x2 = c->x, y2 = c->y;
+  uint32_t color = command->color;
 
   ///////////////////////////////////////////////////////////////////////
   // draw flat-bottom triangle
@@ -122,7 +135,9 @@ void draw_filled_triangle(
   // check if flat-bottom (y1-y0 != 0)
   if (y1 - y0 != 0)
   {
-    for (int y = y0; y <= y1; y++)
+    int y_start = clamp_int(y0, 0, get_window_height());
+    int y_end = clamp_int(y1, -1, get_window_height() - 1);
+    for (int y = y_start; y <= y_end; y++)
     {
       int x_left = x1 + (y - y1) * inv_slope_1;
       int x_right = x0 + (y - y0) * inv_slope_2;
@@ -132,9 +147,12 @@ void draw_filled_triangle(
         int_swap(&x_left, &x_right);
       }
 
+      x_left = clamp_int(x_left, 0, get_window_width());
+      x_right = clamp_int(x_right, 0, get_window_width());
+
       for (int x = x_left; x < x_right; x++)
       {
-        draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
+        draw_triangle_pixel(x, y, color, a, b, c);
       }
     }
   }
@@ -152,7 +170,9 @@ void draw_filled_triangle(
 
   if (y2 - y1 != 0)
   {
-    for (int y = y1; y <= y2; y++)
+    int y_start = clamp_int(y1, 0, get_window_height());
+    int y_end = clamp_int(y2, -1, get_window_height() - 1);
+    for (int y = y_start; y <= y_end; y++)
     {
       int x_left = x1 + (y - y1) * inv_slope_1;
       int x_right = x0 + (y - y0) * inv_slope_2;
@@ -160,22 +180,24 @@ void draw_filled_triangle(
       if (x_left > x_right)
         int_swap(&x_left, &x_right);
 
+      x_left = clamp_int(x_left, 0, get_window_width());
+      x_right = clamp_int(x_right, 0, get_window_width());
+
       for (int x = x_left; x < x_right; x++)
       {
-        draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
+        draw_triangle_pixel(x, y, color, a, b, c);
       }
     }
   }
 }
 
 void draw_texel(
-  int x, int y, upng_t *texture,
-  vec4_t point_a, vec4_t point_b, vec4_t point_c,
-  tex2_t a_uv, tex2_t b_uv, tex2_t c_uv
+  int x, int y, const texture_level_t *texture, bc1_block_cache_t *block_cache,
+  const raster_vertex_t *a, const raster_vertex_t *b, const raster_vertex_t *c
 )
 {
   vec2_t point_p = {x, y};
-  vec3_t weights = barycentric_weights(vec2_from_vec4(point_a), vec2_from_vec4(point_b), vec2_from_vec4(point_c), point_p);
+  vec3_t weights = barycentric_weights(vec2_new(a->x, a->y), vec2_new(b->x, b->y), vec2_new(c->x, c->y), point_p);
 
   float alpha = weights.x;
   float beta = weights.y;
@@ -186,20 +208,20 @@ void draw_texel(
   float interpolated_v;
   float interpolated_reciprocal_w;
 
-  // perform interpolation of all U/w and V/w values using barycentric weights and factor of 1/w
-  interpolated_u = (a_uv.u / point_a.w * alpha) + (b_uv.u / point_b.w * beta) + (c_uv.u / point_c.w * gamma);
-  interpolated_v = (a_uv.v / point_a.w * alpha) + (b_uv.v / point_b.w * beta) + (c_uv.v / point_c.w * gamma);
+  // perform interpolation of all U/w and V/w values using barycentric weights (already divided by w in the command)
+  interpolated_u = (a->u_over_w * alpha) + (b->u_over_w * beta) + (c->u_over_w * gamma);
+  interpolated_v = (a->v_over_w * alpha) + (b->v_over_w * beta) + (c->v_over_w * gamma);
 
   // interpolate value of 1/w for the current pixel
-  interpolated_reciprocal_w = (1 / point_a.w * alpha) + (1 / point_b.w * beta) + (1 / point_c.w * gamma);
+  interpolated_reciprocal_w = (a->inv_w * alpha) + (b->inv_w * beta) + (c->inv_w * gamma);
 
   // divide back both of interpolated values by 1/w
   interpolated_u /= interpolated_reciprocal_w;
   interpolated_v /= interpolated_reciprocal_w;
 
   // get mesh texture width and hight
-  int texture_width = upng_get_width(texture);
-  int texture_height = upng_get_height(texture);
+  int texture_width = texture->width;
+  int texture_height = texture->height;
 
   int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
   int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
@@ -208,65 +230,32 @@ void draw_texel(
   interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
 
   // only draw pixel if the depth value is less than the one previously stored in the z-buffer
+  count_raster(pixels_tested, 1);
   if (interpolated_reciprocal_w < get_zbuffer_at(x, y))
   {
-    uint32_t *texture_buffer = (uint32_t *)upng_get_buffer(texture);
+    count_raster(pixels_passed, 1);
+    count_raster(texels_fetched, 1);
 
-    draw_pixel(x, y, texture_buffer[(texture_width * tex_y) + tex_x]);
+    // compressed textures are decoded only where they are drawn, a block at a time
+    uint32_t texel = texture->blocks != NULL ? decode_bc1_texel(block_cache, texture->blocks, texture->blocks_per_row, tex_x, tex_y)
+                                             : texture->texels[(texture_width * tex_y) + tex_x];
+    draw_pixel(x, y, texel);
 
     // update z-buffer value with 1/w of this current pixel
     set_zbuffer_at(x, y, interpolated_reciprocal_w);
   }
 }
 
-void draw_textured_triangle(
-  int x0, int y0, float z0, float w0, float u0, float v0, // vertex A
-  int x1, int y1, float z1, float w1, float u1, float v1, // vertex A
-  int x2, int y2, float z2, float w2, float u2, float v2, // vertex A
-  upng_t *texture
-)
+void draw_textured_triangle(const render_command_t *command)
 {
-  // sort vertices by y-coordinate (y0 < y1 < y3)
-  if (y0 > y1)
-  {
-    int_swap(&y0, &y1);
-    int_swap(&x0, &x1);
-    float_swap(&z0, &z1);
-    float_swap(&w0, &w1);
-    float_swap(&u0, &u1);
-    float_swap(&v0, &v1);
-  }
-  if (y1 > y2)
-  {
-    int_swap(&y1, &y2);
-    int_swap(&x1, &x2);
-    float_swap(&z1, &z2);
-    float_swap(&w1, &w2);
-    float_swap(&u1, &u2);
-    float_swap(&v1, &v2);
-  }
-  if (y0 > y1)
-  {
-    int_swap(&y0, &y1);
-    int_swap(&x0, &x1);
-    float_swap(&z0, &z1);
-    float_swap(&w0, &w1);
-    float_swap(&u0, &u1);
-    float_swap(&v0, &v1);
-  }
+  const raster_vertex_t *a, *b, *c;
+  sort_raster_vertices(command, &a, &b, &c);
 
-  // flip V component for inverted UV-coordinates
-  v0 = 1.0 - v0;
-  v1 = 1.0 - v1;
-  v2 = 1.0 - v2;
-
-  // vector points and texture coordinates
-  vec4_t point_a = {x0, y0, z0, w0};
-  vec4_t point_b = {x1, y1, z1, w1};
-  vec4_t point_c = {x2, y2, z2, w2};
-  tex2_t a_uv = {u0, v0};
-  tex2_t b_uv = {u1, v1};
-  tex2_t c_uv = {u2, v2};
+  int x0 = a->x, y0 = a->y;
+  int x1 = b->x, y1 = b->y;
+  int x2 = c->x, y2 = c->y;
+  const texture_level_t *texture = command->texture;
+  bc1_block_cache_t block_cache = {.block = -1};
 
   ///////////////////////////////////////////////////////////////////////
   // draw flat-bottom triangle
@@ -282,7 +271,9 @@ void draw_textured_triangle(
   // check if flat-bottom (y1-y0 != 0)
   if (y1 - y0 != 0)
   {
-    for (int y = y0; y <= y1; y++)
+    int y_start = clamp_int(y0, 0, get_window_height());
+    int y_end = clamp_int(y1, -1, get_window_height() - 1);
+    for (int y = y_start; y <= y_end; y++)
     {
       int x_left = x1 + (y - y1) * inv_slope_1;
       int x_right = x0 + (y - y0) * inv_slope_2;
@@ -290,9 +281,12 @@ void draw_textured_triangle(
       if (x_left > x_right)
         int_swap(&x_left, &x_right);
 
+      x_left = clamp_int(x_left, 0, get_window_width());
+      x_right = clamp_int(x_right, 0, get_window_width());
+
       for (int x = x_left; x < x_right; x++)
       {
-        draw_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+        draw_texel(x, y, texture, &block_cache, a, b, c);
       }
     }
   }
@@ -310,7 +304,9 @@ void draw_textured_triangle(
 
   if (y2 - y1 != 0)
   {
-    for (int y = y1; y <= y2; y++)
+    int y_start = clamp_int(y1, 0, get_window_height());
+    int y_end = clamp_int(y2, -1, get_window_height() - 1);
+    for (int y = y_start; y <= y_end; y++)
     {
       int x_left = x1 + (y - y1) * inv_slope_1;
       int x_right = x0 + (y - y0) * inv_slope_2;
@@ -318,9 +314,12 @@ void draw_textured_triangle(
       if (x_left > x_right)
         int_swap(&x_left, &x_right);
 
+      x_left = clamp_int(x_left, 0, get_window_width());
+      x_right = clamp_int(x_right, 0, get_window_width());
+
       for (int x = x_left; x < x_right; x++)
       {
-        draw_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+        draw_texel(x, y, texture, &block_cache, a, b, c);
       }
     }
   }
@@ -0,0 +1,308 @@
+#include "vertex_cache.h"
+#include "array.h"
+#include "asset.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WELD_TABLE_MIN_CAPACITY 1024
+
+// positions and UVs are compared bit for bit, so a welded vertex is exactly
+// the corner it replaces
+static bool is_same_vertex(mesh_vertex_t a, mesh_vertex_t b)
+{
+  return memcmp(&a, &b, sizeof(mesh_vertex_t)) == 0;
+}
+
+static void insert_weld_slot(vertex_weld_table_t *table, mesh_vertex_t *welded_vertices, int index)
+{
+  uint64_t hash = fnv1a_hash(&welded_vertices[index], sizeof(mesh_vertex_t));
+  int slot = hash & (table->capacity - 1);
+  while (table->slots[slot] != 0)
+  {
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+  table->slots[slot] = index + 1;
+}
+
+// keep the table at most half full
+static void grow_weld_table(vertex_weld_table_t *table, mesh_vertex_t *welded_vertices)
+{
+  int capacity = table->capacity > 0 ? table->capacity * 2 : WELD_TABLE_MIN_CAPACITY;
+  free(table->slots);
+  table->slots = (int *)calloc(capacity, sizeof(int));
+  table->capacity = capacity;
+  for (int i = 0; i < table->num_used; i++)
+  {
+    insert_weld_slot(table, welded_vertices, i);
+  }
+}
+
+static uint32_t weld_vertex(vertex_weld_table_t *table, mesh_vertex_t **welded_vertices, mesh_vertex_t vertex)
+{
+  if ((table->num_used + 1) * 2 > table->capacity)
+  {
+    grow_weld_table(table, *welded_vertices);
+  }
+
+  uint64_t hash = fnv1a_hash(&vertex, sizeof(mesh_vertex_t));
+  int slot = hash & (table->capacity - 1);
+  while (table->slots[slot] != 0)
+  {
+    int index = table->slots[slot] - 1;
+    if (is_same_vertex((*welded_vertices)[index], vertex))
+    {
+      return index;
+    }
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+
+  array_push(*welded_vertices, vertex);
+  table->slots[slot] = table->num_used + 1;
+  return table->num_used++;
+}
+
+uint32_t *weld_face_vertices(vertex_weld_table_t *table, mesh_vertex_t **welded_vertices, vec3_t *positions, face_t *faces)
+{
+  int num_faces = array_length(faces);
+  if (num_faces == 0)
+  {
+    return NULL;
+  }
+
+  uint32_t *indices = array_hold(NULL, num_faces * 3, sizeof(uint32_t));
+  if (indices == NULL)
+  {
+    return NULL;
+  }
+
+  for (int i = 0; i < num_faces; i++)
+  {
+    face_t *face = &faces[i];
+    indices[i * 3 + 0] = weld_vertex(table, welded_vertices, (mesh_vertex_t){positions[face->a], face->a_uv});
+    indices[i * 3 + 1] = weld_vertex(table, welded_vertices, (mesh_vertex_t){positions[face->b], face->b_uv});
+    indices[i * 3 + 2] = weld_vertex(table, welded_vertices, (mesh_vertex_t){positions[face->c], face->c_uv});
+  }
+  return indices;
+}
+
+void free_vertex_weld_table(vertex_weld_table_t *table)
+{
+  free(table->slots);
+  *table = (vertex_weld_table_t){0};
+}
+
+typedef struct
+{
+  uint32_t index;
+  int corner;
+} corner_sort_entry_t;
+
+static int compare_corner_sort_entries(const void *a, const void *b)
+{
+  uint32_t index_a = ((const corner_sort_entry_t *)a)->index;
+  uint32_t index_b = ((const corner_sort_entry_t *)b)->index;
+  return (index_a > index_b) - (index_a < index_b);
+}
+
+// number the vertices the faces use from 0, so the ordering below only needs
+// arrays as large as the faces and not as the whole mesh; returns the count,
+// -1 when out of memory
+static int number_local_vertices(const uint32_t *indices, int num_corners, int *local_indices)
+{
+  corner_sort_entry_t *entries = (corner_sort_entry_t *)malloc(sizeof(corner_sort_entry_t) * num_corners);
+  if (entries == NULL)
+  {
+    return -1;
+  }
+  for (int i = 0; i < num_corners; i++)
+  {
+    entries[i] = (corner_sort_entry_t){indices[i], i};
+  }
+  qsort(entries, num_corners, sizeof(corner_sort_entry_t), compare_corner_sort_entries);
+
+  int num_vertices = 0;
+  for (int i = 0; i < num_corners; i++)
+  {
+    if (i > 0 && entries[i].index != entries[i - 1].index)
+    {
+      num_vertices++;
+    }
+    local_indices[entries[i].corner] = num_vertices;
+  }
+  free(entries);
+  return num_vertices + 1;
+}
+
+bool order_faces_for_vertex_cache(const uint32_t *indices, int num_faces, int *face_order)
+{
+  if (num_faces <= 0)
+  {
+    return true;
+  }
+
+  int num_corners = num_faces * 3;
+  int *local_indices = (int *)malloc(sizeof(int) * num_corners);
+  int num_vertices = local_indices != NULL ? number_local_vertices(indices, num_corners, local_indices) : -1;
+  if (num_vertices < 0)
+  {
+    free(local_indices);
+    return false;
+  }
+
+  // faces around each vertex: first_adjacent[v] .. first_adjacent[v + 1] in adjacent_faces
+  int *first_adjacent = (int *)calloc(num_vertices + 1, sizeof(int));
+  int *adjacent_faces = (int *)malloc(sizeof(int) * num_corners);
+  int *live_faces = (int *)calloc(num_vertices, sizeof(int));
+  int *cache_time = (int *)calloc(num_vertices, sizeof(int));
+  int *dead_ends = (int *)malloc(sizeof(int) * num_corners);
+  int *candidates = (int *)malloc(sizeof(int) * num_corners);
+  bool *is_emitted = (bool *)calloc(num_faces, sizeof(bool));
+  int *fill = (int *)malloc(sizeof(int) * num_vertices);
+  if (first_adjacent == NULL || adjacent_faces == NULL || live_faces == NULL || cache_time == NULL || dead_ends == NULL ||
+      candidates == NULL || is_emitted == NULL || fill == NULL)
+  {
+    free(local_indices);
+    free(first_adjacent);
+    free(adjacent_faces);
+    free(live_faces);
+    free(cache_time);
+    free(dead_ends);
+    free(candidates);
+    free(is_emitted);
+    free(fill);
+    return false;
+  }
+
+  for (int i = 0; i < num_corners; i++)
+  {
+    live_faces[local_indices[i]]++;
+  }
+  for (int v = 0; v < num_vertices; v++)
+  {
+    first_adjacent[v + 1] = first_adjacent[v] + live_faces[v];
+  }
+  memcpy(fill, first_adjacent, sizeof(int) * num_vertices);
+  for (int i = 0; i < num_corners; i++)
+  {
+    adjacent_faces[fill[local_indices[i]]++] = i / 3;
+  }
+  free(fill);
+
+  // a vertex is in the cache while fewer than VERTEX_CACHE_SIZE vertices
+  // entered after it, which is when time - cache_time <= VERTEX_CACHE_SIZE
+  int time = VERTEX_CACHE_SIZE + 1;
+  int num_ordered = 0;
+  int num_dead_ends = 0;
+  int cursor = 0;
+  int fan_vertex = 0;
+  while (fan_vertex >= 0)
+  {
+    // emit every face left around the vertex
+    int num_candidates = 0;
+    for (int i = first_adjacent[fan_vertex]; i < first_adjacent[fan_vertex + 1]; i++)
+    {
+      int face = adjacent_faces[i];
+      if (is_emitted[face])
+        continue;
+
+      is_emitted[face] = true;
+      face_order[num_ordered++] = face;
+      for (int j = 0; j < 3; j++)
+      {
+        int v = local_indices[face * 3 + j];
+        dead_ends[num_dead_ends++] = v;
+        candidates[num_candidates++] = v;
+        live_faces[v]--;
+        if (time - cache_time[v] > VERTEX_CACHE_SIZE)
+        {
+          cache_time[v] = time++;
+        }
+      }
+    }
+
+    // next fan around the vertex that stays in the cache the longest once
+    // its remaining faces are emitted
+    fan_vertex = -1;
+    int best_priority = -1;
+    for (int i = 0; i < num_candidates; i++)
+    {
+      int v = candidates[i];
+      if (live_faces[v] == 0)
+        continue;
+
+      int priority = 0;
+      if (time - cache_time[v] + 2 * live_faces[v] <= VERTEX_CACHE_SIZE)
+      {
+        priority = time - cache_time[v];
+      }
+      if (priority > best_priority)
+      {
+        best_priority = priority;
+        fan_vertex = v;
+      }
+    }
+
+    // dead end: go back to a recently used vertex with faces left, or to
+    // the next such vertex in order
+    while (fan_vertex < 0 && num_dead_ends > 0)
+    {
+      int v = dead_ends[--num_dead_ends];
+      if (live_faces[v] > 0)
+      {
+        fan_vertex = v;
+      }
+    }
+    while (fan_vertex < 0 && cursor < num_vertices)
+    {
+      if (live_faces[cursor] > 0)
+      {
+        fan_vertex = cursor;
+      }
+      cursor++;
+    }
+  }
+
+  free(local_indices);
+  free(first_adjacent);
+  free(adjacent_faces);
+  free(live_faces);
+  free(cache_time);
+  free(dead_ends);
+  free(candidates);
+  free(is_emitted);
+  return true;
+}
+
+float get_vertex_cache_miss_ratio(const uint32_t *indices, int num_faces)
+{
+  if (num_faces == 0)
+  {
+    return 0;
+  }
+
+  uint32_t cache[VERTEX_CACHE_SIZE];
+  memset(cache, 0xff, sizeof(cache));
+  int next = 0;
+  int num_misses = 0;
+  for (int i = 0; i < num_faces * 3; i++)
+  {
+    bool is_hit = false;
+    for (int j = 0; j < VERTEX_CACHE_SIZE; j++)
+    {
+      if (cache[j] == indices[i])
+      {
+        is_hit = true;
+        break;
+      }
+    }
+
+    if (!is_hit)
+    {
+      cache[next] = indices[i];
+      next = (next + 1) % VERTEX_CACHE_SIZE;
+      num_misses++;
+    }
+  }
+  return (float)num_misses / num_faces;
+}
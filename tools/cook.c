@@ -0,0 +1,75 @@
+#include "array.h"
+#include "asset.h"
+#include "cooked_mesh.h"
+#include "mesh.h"
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// parse every OBJ file given and write its cooked mesh next to it, so the
+// renderer maps the finished arrays instead of parsing and simplifying
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s file.obj...\n", argv[0]);
+    return 1;
+  }
+
+  int num_failed = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    char cooked_path[1024];
+    if (!get_cooked_mesh_path(argv[i], cooked_path, sizeof(cooked_path)))
+    {
+      fprintf(stderr, "Error: path %s is too long.\n", argv[i]);
+      num_failed++;
+      continue;
+    }
+
+    size_t size;
+    const unsigned char *bytes = map_file(argv[i], &size);
+    if (bytes == NULL)
+    {
+      num_failed++;
+      continue;
+    }
+
+    uint64_t start = SDL_GetTicksNS();
+    mesh_t mesh = {0};
+    load_mesh_obj_data(&mesh, (const char *)bytes, size);
+    bool is_written = write_cooked_mesh(cooked_path, &mesh, fnv1a_hash(bytes, size));
+    unmap_file(bytes, size);
+
+    if (is_written)
+    {
+      printf(
+        "%s: %d vertices (%d welded), %d faces in %d levels of detail, %.3f vertex cache misses per face in file order and %.3f reordered, cooked in %.3f ms\n",
+        cooked_path,
+        array_length(mesh.vertices),
+        array_length(mesh.welded_vertices),
+        array_length(mesh.lods[0].faces),
+        mesh.num_lods,
+        mesh.cache_miss_ratio_before,
+        mesh.cache_miss_ratio_after,
+        (SDL_GetTicksNS() - start) / 1e6
+      );
+    }
+    else
+    {
+      num_failed++;
+    }
+
+    for (int j = 0; j < mesh.num_lods; j++)
+    {
+      array_free(mesh.lods[j].faces);
+      array_free(mesh.lods[j].face_planes);
+      array_free(mesh.lods[j].meshlets);
+      array_free(mesh.lods[j].indices);
+    }
+    array_free(mesh.vertices);
+    array_free(mesh.welded_vertices);
+  }
+
+  return num_failed > 0 ? 1 : 0;
+}